@@ -1,9 +1,14 @@
 #ifndef B_LEXER_H
 #define B_LEXER_H
 
+#include "creole_source.h"
 #include "i_lexer.h"
+#include <iterator>
+#include <list>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class BlockTokenType {
@@ -19,51 +24,168 @@ enum class BlockTokenType {
   ENDOF,
 };
 
+/* text is a view into the lexer's source buffer (or rarely its owned_text),
+it stays valid as long as the BLexer that produced it.
+offset is the byte where the block starts, BLexer::position turns it into a
+line and column */
 struct BToken {
   BlockTokenType type;
-  size_t loc;
-  std::optional<std::string> text; // raw text
-  std::optional<int> level;        // for heading, ul, ol
-  std::vector<IToken> i_tokens;    // from ILexer
+  size_t offset;
+  std::optional<std::string_view> text; // raw text
+  std::optional<int> level;             // for heading, ul, ol
+  ITokenArena i_tokens;                 // from ILexer
+
+  /* owned copy, only made when a consumer asks for it */
+  std::string text_string() const { return std::string(text.value_or("")); }
+};
+
+/*
+ * Pull interface over block tokens, BLexer and BStreamLexer implement it.
+ * Tokens are moved out one at a time, so a consumer can build while the lexer
+ * is still reading and no token vector is kept around:
+ *   for (BToken &t : lexer) { ... }
+ */
+class BTokenSource {
+public:
+  virtual ~BTokenSource() = default;
+
+  /* moves the next token into out, false once ENDOF was handed out */
+  virtual bool next_token(BToken &out) = 0;
+
+  class iterator {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = BToken;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(BTokenSource *source) : source(source) { ++*this; }
+
+    BToken &operator*() { return current; }
+    BToken *operator->() { return &current; }
+    iterator &operator++() {
+      if (source && !source->next_token(current)) {
+        source = nullptr;
+      }
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+    bool operator==(std::default_sentinel_t) const { return !source; }
+
+  private:
+    BTokenSource *source{nullptr};
+    BToken current{};
+  };
+
+  iterator begin() { return iterator(this); }
+  std::default_sentinel_t end() { return {}; }
 };
 
-class BLexer {
+/* error channel of the lexer cores, b_tokenize turns it into a B_LexerError */
+enum class LexErrorCode {
+  NONE,
+  UNEXPECTED_END,   // a '{'/'}' run, marker run or last line cut by the end
+  ADVANCE_PAST_END, // a block needed more bytes than are left
+};
+
+/* replaces removed bytes at offset with inserted */
+struct TextEdit {
+  size_t offset;
+  size_t removed;
+  std::string inserted;
+};
+
+/* tokens [first, first + count) now stand where old_count tokens were */
+struct TokenRange {
+  size_t first;
+  size_t count;
+  size_t old_count;
+};
+
+class BLexer : public BTokenSource {
 public:
   explicit BLexer(const std::string &filepath);
-  void b_tokenize(); // block tokenizer
+  explicit BLexer(std::shared_ptr<const CreoleSource> source,
+                  size_t first_line = 1);
+  void b_tokenize();   // block tokenizer
+  bool try_tokenize(); // same, false on error instead of throwing
+  LexErrorCode last_error() const { return error; }
+  void b_tokenize_parallel(size_t n_threads = 0); // same tokens, many cores
+  /* lexes one block per call instead, use either this or b_tokenize */
+  bool next_token(BToken &out) override;
   void print_tokens();
-  std::vector<BToken> get_tokens();
+  const std::vector<BToken> &get_tokens() const;
+  std::shared_ptr<const CreoleSource> get_source() const;
+  LinePos position(size_t offset) const; // of a token or error offset
 
   /*=== Inline ===*/
   void process_inline_tokens();
 
+  /*=== Splitting ===*/
+  /* line starts where the lexer is always between two blocks, unless a
+  verbatim block is still open (see has_open_block) */
+  static bool is_block_boundary(std::string_view data, size_t at);
+  static size_t last_block_boundary(std::string_view data); // npos if none
+  static size_t next_block_boundary(std::string_view data, size_t from);
+  bool has_open_block() const; // input ended inside a verbatim block
+
+  /*=== Incremental ===*/
+  /* applies edit to the source and re-lexes only the blocks around it */
+  TokenRange relex(const TextEdit &edit);
+
 private:
+  friend class BStreamLexer;
+
+  /* lexes only range, a slice of source, used for parallel chunks */
+  BLexer(std::shared_ptr<const CreoleSource> source, std::string_view range,
+         size_t first_line);
+
   std::vector<BToken> tokens;
-  std::string creole_data;
+  std::shared_ptr<const CreoleSource> source;
+  std::string_view creole_data;       // bytes of source, scanned in place
+  std::list<std::string> owned_text;  // text that is not a slice of source
   size_t pos;
-  size_t loc;
+  size_t base;        // offset of creole_data[0] in the source
+  size_t first_line;  // line number of the first source byte
+  size_t block_start; // offset of the block being read
+  bool open_verbatim{false};
+  LexErrorCode error{LexErrorCode::NONE};
+  size_t error_pos{0};   // pos when the error was recorded
+  size_t error_steps{0}; // bytes the failed advance wanted
+  bool endof_pulled{false}; // next_token handed out ENDOF
+  bool inline_done{false}; // process_inline_tokens ran, relex keeps it up
 
   /*=== Printing Functions ===*/
   std::string token_to_string(BlockTokenType type);
 
   /*=== Reading Functions ===*/
-  void read_heading();       // heaading with different levels
-  void read_uli();           // unordered list item
-  void read_oli();           // ordered list item
-  void read_horizonalrule(); // horizontal rule
-  void read_paragraph();     // normal paragraph lines
-  void read_verbatim();      // verbatim block
-  void read_blankline();
-  void read_image(); // image with text (link(url) and alt text)
+  /* all return false after recording an error with fail() */
+  bool lex_block();          // one block from pos
+  bool read_heading();       // heaading with different levels
+  bool read_uli();           // unordered list item
+  bool read_oli();           // ordered list item
+  bool read_horizonalrule(); // horizontal rule
+  bool read_paragraph();     // normal paragraph lines
+  bool read_verbatim();      // verbatim block
+  bool read_blankline();
+  bool read_image(); // image with text (link(url) and alt text)
 
   /*=== Helper Functions ===*/
-  inline bool end();
-  void advance(size_t offset = 1);
-  char peek();
-  char lookahead(size_t offset = 1);
-  inline bool is_newline();
-  inline bool is_whites();
-  inline bool is_special();
+  size_t current_line(); // for errors
+  bool fail(LexErrorCode code, size_t steps = 0);
+  [[noreturn]] void throw_error() const;
+  inline bool end() const;
+  inline void advance(size_t offset = 1);
+  void skip_line(); // to the next '\n' without per-byte work
+  inline bool skip_newline();
+  inline char peek() const; // '\0' at the end
+  inline char lookahead(size_t offset = 1) const;
+  inline bool at_verbatim_open() const;  // "{{{"
+  inline bool at_verbatim_close() const; // "}}}"
+  inline bool brace_cut_by_end() const;
+  inline bool is_newline() const;
+  inline bool is_whites() const;
+  inline bool is_special() const;
 };
 
 #endif // !B_LEXER_H
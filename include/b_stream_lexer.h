@@ -0,0 +1,57 @@
+#ifndef B_STREAM_LEXER_H
+#define B_STREAM_LEXER_H
+
+#include "b_lexer.h"
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+Rules:
+- class and struct will be named in PascalCase
+- class member functions and members will be named in snake_case
+*/
+
+/*
+Streaming front end for BLexer, for inputs too big to hold in memory.
+- reads fixed-size chunks from an istream or a file descriptor
+- lexes the buffered bytes up to the last block boundary as one batch and
+  keeps the rest for the next read, blocks crossing a chunk (paragraphs,
+  nested {{{ }}}) simply stay buffered until they are complete
+- memory is bounded by the largest block, not by the input size
+- a token's text stays valid until the next call to next_token
+*/
+class BStreamLexer : public BTokenSource {
+public:
+  explicit BStreamLexer(std::istream &in, size_t chunk_size = 1 << 20);
+  explicit BStreamLexer(int fd, size_t chunk_size = 1 << 20);
+
+  bool next_token(BToken &out) override;
+
+  size_t buffered_bytes() const; // read from input, not lexed yet
+
+  /* line/column of an offset of the tokens handed out since the last batch */
+  LinePos position(size_t offset) const;
+
+private:
+  std::istream *in;
+  int fd;
+  size_t chunk_size;
+
+  std::string window;                  // unlexed bytes, starts at a block
+  size_t want;                         // bytes to read before next attempt
+  size_t loc;                          // line number of window[0]
+  size_t offset;                       // input byte offset of window[0]
+  size_t batch_offset;                 // input byte offset of the batch
+  std::unique_ptr<BLexer> batch_lexer; // owns the text of batch tokens
+  std::vector<BToken> batch;
+  size_t batch_pos;
+  bool eof;
+  bool done;
+
+  bool read_chunk(); // false at end of input
+  bool lex_next_batch();
+};
+
+#endif //! B_STREAM_LEXER_H
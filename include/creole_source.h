@@ -0,0 +1,60 @@
+#ifndef CREOLE_SOURCE_H
+#define CREOLE_SOURCE_H
+
+#include "line_table.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+/*
+Rules:
+- class and struct will be named in PascalCase
+- class member functions and members will be named in snake_case
+*/
+
+/*
+ * Read-only view over the raw bytes of a creole document.
+ * Regular files are memory mapped so the lexers can scan the bytes in place
+ * without copying them; pipes, stdin ("-") and other non-mappable inputs fall
+ * back to a single owned read buffer.
+ * Either way the bytes are followed by `padding` NUL bytes, so the lexers can
+ * look a few bytes ahead without checking for the end first.
+ */
+class CreoleSource {
+public:
+  static constexpr size_t padding = 32;
+
+  static std::shared_ptr<const CreoleSource> open(const std::string &filepath);
+  static std::shared_ptr<const CreoleSource> from_string(std::string data);
+
+  ~CreoleSource();
+  CreoleSource(const CreoleSource &) = delete;
+  CreoleSource &operator=(const CreoleSource &) = delete;
+
+  std::string_view view() const { return {data_, size_}; }
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool is_mapped() const { return mapped_ != nullptr; }
+
+  /* line starts, built by the first caller (any thread) and then shared */
+  const LineTable &lines() const;
+  /* offset of a view into these bytes, npos for any other string */
+  size_t offset_of(std::string_view text) const;
+
+private:
+  CreoleSource() = default;
+
+  const char *data_{nullptr};
+  size_t size_{0};
+  void *mapped_{nullptr}; // base of the mapping, if any
+  size_t mapped_size_{0};
+  std::string owned_; // fallback storage for non-mappable input
+  mutable std::once_flag lines_once_;
+  mutable LineTable lines_;
+
+  bool map_file(int fd, size_t size);
+  void read_fd(int fd);
+};
+
+#endif //! CREOLE_SOURCE_H
@@ -3,6 +3,7 @@
 
 #include "migr.h"
 #include "rapidjson/document.h"
+#include <algorithm>
 
 using Document = rapidjson::Document;
 using Value = rapidjson::Value;
@@ -10,65 +11,75 @@ using Value = rapidjson::Value;
 class DeserializationEngine {
 public:
   /* reads the MigrNode node from JSON */
-  static std::shared_ptr<MIGRNode> read_node(const Value &json) {
+  static MIGRNode *read_node(const Value &json, NodeArena &arena,
+                             StringPool &strings) {
     if (!json.IsObject()) {
       return nullptr;
     }
 
     MIGRNodeType type = static_cast<MIGRNodeType>(json["type"].GetInt());
     std::string content = std::string(json["content"].GetString());
-    auto node = std::make_shared<MIGRNode>(type, content);
+    MIGRNode *node = arena.make(type, content);
 
     if (json.HasMember("metadata")) {
       const auto &meta = json["metadata"];
       for (auto it = meta.MemberBegin(); it != meta.MemberEnd(); ++it) {
-        node->metadata_[it->name.GetString()] = it->value.GetString();
+        node->set_attr(it->name.GetString(), it->value.GetString(),
+                       strings);
       }
     }
 
     return node;
   }
 
-  /* reads the [id : MigrNode] nodes map from JSON */
-  static std::unordered_map<std::string, std::shared_ptr<MIGRNode>>
-  read_nodes(const Value &json) {
-    std::unordered_map<std::string, std::shared_ptr<MIGRNode>> nodes;
+  /* reads the [id : MigrNode] nodes map from JSON, nodes are made in arena
+  and their refs interned in strings */
+  static NodeMap<MIGRNode *> read_nodes(const Value &json, NodeArena &arena,
+                                        StringPool &strings) {
+    NodeMap<MIGRNode *> nodes;
 
     if (!json.HasMember("nodes")) {
       return nodes;
     }
 
     const auto &nob = json["nodes"]; // nodes object
+    NodeId last{no_node};
     for (auto it = nob.MemberBegin(); it != nob.MemberEnd(); ++it) {
-      std::string id = it->name.GetString();
-      auto node = read_node(it->value);
-      if (node) {
+      NodeId id = MIGRNode::parse_id(it->name.GetString());
+      MIGRNode *node = read_node(it->value, arena, strings);
+      if (node && id != no_node) {
         node->id_ = id;
         nodes[id] = node;
+        last = std::max(last, id);
       }
     }
+    // after the loop, a high id read first must not stop the nodes after it
+    MIGRNode::reserve_id(last);
     return nodes;
   }
 
   /* builds the parent child hieratchy from the JSON file */
-  static void build_hieratchy(
-      const Value &json,
-      std::unordered_map<std::string, std::shared_ptr<MIGRNode>> &nodes) {
+  static void build_hieratchy(const Value &json,
+                              NodeMap<MIGRNode *> &nodes) {
     if (!json.HasMember("nodes")) {
       return;
     }
 
     const auto &nob = json["nodes"];
     for (auto it = nob.MemberBegin(); it != nob.MemberEnd(); ++it) {
-      std::string id = it->name.GetString();
+      auto node_ptr = nodes.find(MIGRNode::parse_id(it->name.GetString()));
+      if (!node_ptr) {
+        continue;
+      }
       const auto &node_json = it->value;
-      auto node = nodes[id];
+      MIGRNode *node = *node_ptr;
 
       // setting parent of node
       if (node_json.HasMember("parent")) {
-        std::string parent_id = node_json["parent"].GetString();
-        if (nodes.count(parent_id)) {
-          node->parent_ = nodes[parent_id];
+        auto parent = nodes.find(
+            MIGRNode::parse_id(node_json["parent"].GetString()));
+        if (parent) {
+          node->parent_ = *parent;
         }
       }
 
@@ -76,9 +87,9 @@ public:
       if (node_json.HasMember("children")) {
         const auto &children = node_json["children"];
         for (auto &child_val : children.GetArray()) {
-          std::string child_id = child_val.GetString();
-          if (nodes.count(child_id)) {
-            node->children_.push_back(nodes[child_id]);
+          auto child = nodes.find(MIGRNode::parse_id(child_val.GetString()));
+          if (child) {
+            node->children_.push_back(*child);
           }
         }
       }
@@ -97,8 +108,8 @@ public:
     const auto &edges_arr = json["edges"];
     for (auto &edge_val : edges_arr.GetArray()) {
       EdgeType edge;
-      edge.source_id = edge_val["source"].GetString();
-      edge.target_id = edge_val["target"].GetString();
+      edge.source_id = MIGRNode::parse_id(edge_val["source"].GetString());
+      edge.target_id = MIGRNode::parse_id(edge_val["target"].GetString());
       edge.edge_type = static_cast<MIGREdgeType>(edge_val["type"].GetInt());
 
       if constexpr (requires { edge.relation_label; }) {
@@ -111,10 +122,10 @@ public:
     return edges;
   }
 
-  /* read string-to-string map from JSON file */
-  static std::unordered_map<std::string, std::string>
-  read_map(const Value &json, const char *key) {
-    std::unordered_map<std::string, std::string> map;
+  /* read string-to-id map from JSON file, keys interned in strings */
+  static std::unordered_map<InternedStr, NodeId>
+  read_map(const Value &json, const char *key, StringPool &strings) {
+    std::unordered_map<InternedStr, NodeId> map;
 
     if (!json.HasMember(key)) {
       return map;
@@ -122,16 +133,17 @@ public:
 
     const auto &obj = json[key];
     for (auto it = obj.MemberBegin(); it != obj.MemberEnd(); ++it) {
-      map[it->name.GetString()] = it->value.GetString();
+      map[strings.intern(it->name.GetString())] =
+          MIGRNode::parse_id(it->value.GetString());
     }
 
     return map;
   }
 
-  /* read string-to-vector map (indexes) from JSON file */
-  static std::unordered_map<std::string, std::vector<size_t>>
-  read_index(const Value &json, const char *key) {
-    std::unordered_map<std::string, std::vector<size_t>> map;
+  /* read id-to-vector map (indexes) from JSON file */
+  static NodeMap<std::vector<size_t>> read_index(const Value &json,
+                                                 const char *key) {
+    NodeMap<std::vector<size_t>> map;
 
     if (!json.HasMember(key)) {
       return map;
@@ -139,12 +151,14 @@ public:
 
     const auto &obj = json[key];
     for (auto it = obj.MemberBegin(); it != obj.MemberEnd(); ++it) {
-      std::string id = it->name.GetString();
+      NodeId id = MIGRNode::parse_id(it->name.GetString());
       std::vector<size_t> vec;
       for (auto &val : it->value.GetArray()) {
         vec.push_back(val.GetUint64());
       }
-      map[id] = vec;
+      if (id != no_node) {
+        map[id] = vec;
+      }
     }
     return map;
   }
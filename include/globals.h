@@ -1,13 +1,14 @@
 #ifndef GLOBALS_H
 #define GLOBALS_H
 
+#include "trace.h"
 #include <iostream>
 
 inline bool verbose = false;
 
-/* output when verbose is true */
+/* output when verbose is true, compiled out with CN_TRACE_LEVEL=0 */
 #define _V_                                                                    \
-  if (verbose)                                                                 \
+  if (TraceLevel::STAGE <= trace_level && verbose)                             \
   std::cerr << "[VERBOSE] "
 
 /* output always as cerr output stream */
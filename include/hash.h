@@ -0,0 +1,22 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <string_view>
+
+/*
+Stable 64-bit hashing for node content and subtree hashes.
+- the same bytes and seed give the same hash on every run, compiler and
+  platform (words are read little endian), unlike std::hash
+- xxHash64 style: 8 bytes per round, then an avalanche of the state
+- not for security, only for change detection and equality checks
+*/
+
+inline constexpr uint64_t hash_seed = 0x6372656f6c79ULL; // "creoly"
+
+uint64_t hash64(std::string_view data, uint64_t seed = hash_seed);
+
+/* order dependent combination of two hashes, for subtree hashes */
+uint64_t hash_combine(uint64_t h, uint64_t v);
+
+#endif //! HASH_H
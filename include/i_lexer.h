@@ -1,8 +1,12 @@
 #ifndef I_LEXER_H
 #define I_LEXER_H
 
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 /*
@@ -23,12 +27,59 @@ enum class InlineTokenType {
   ENDOF,
 };
 
+/* a run of sibling tokens in an ITokenArena, by index */
+struct ITokenRange {
+  uint32_t first{0};
+  uint32_t count{0};
+};
+
+/* content and url are views into the text given to ILexer::tokenize, they
+stay valid as long as that text does.
+offset is where the token starts, counted from the base offset given to
+tokenize (the text's offset in the document) */
 struct IToken {
   InlineTokenType type;
-  size_t loc;
-  std::optional<std::string> content;
-  std::optional<std::string> url; // for links and images
-  std::vector<IToken> children;   // for nested formatting **//
+  size_t offset;
+  std::optional<std::string_view> content;
+  std::optional<std::string_view> url; // for links and images
+  ITokenRange children; // for nested formatting **//, in the same arena
+
+  /* owned copies, only made when a consumer asks for them */
+  std::string content_string() const {
+    return std::string(content.value_or(""));
+  }
+  std::string url_string() const { return std::string(url.value_or("")); }
+};
+
+/*
+Flat storage of the inline token tree of one block.
+- all tokens sit in one array, siblings next to each other, so children are
+  an index range instead of a vector per token
+- a span's children are stored before the span itself, the top level tokens
+  come last
+- reset() drops the tokens but keeps the memory, an arena reused for every
+  block stops allocating once it has seen the biggest one
+*/
+class ITokenArena {
+public:
+  std::span<const IToken> roots() const { return range(root_range); }
+  std::span<const IToken> children(const IToken &t) const {
+    return range(t.children);
+  }
+  std::span<const IToken> range(ITokenRange r) const {
+    return {tokens.data() + r.first, r.count};
+  }
+  std::span<IToken> all() { return tokens; } // every token, in storage order
+  bool empty() const { return root_range.count == 0; }
+  void reset() {
+    tokens.clear();
+    root_range = {};
+  }
+
+private:
+  friend class ILexer;
+  std::vector<IToken> tokens;
+  ITokenRange root_range;
 };
 
 /*
@@ -40,11 +91,15 @@ FSM (Finite State Machine) handling of inline tokens
 class ILexer {
 public:
   ILexer() = default;
-  std::vector<IToken> tokenize(const std::string &input, size_t s_loc = 0);
+  ITokenArena tokenize(std::string_view input, size_t s_offset = 0);
+  /* same tokens, kept in the lexer's arena and valid until its next call, so
+  a lexer reused across blocks also reuses its memory */
+  const ITokenArena &tokenize_in_place(std::string_view input,
+                                       size_t s_offset = 0);
 
   /*=== Printing ===*/
   static std::string token_type_to_string(InlineTokenType type);
-  static void print_inline_tokens(const std::vector<IToken> &tokens);
+  static void print_inline_tokens(const ITokenArena &tokens);
 
 private:
   enum class State {
@@ -58,28 +113,45 @@ private:
   };
 
   /* State Variables */
-  std::vector<IToken> i_tokens;
-  std::string curr_text;
+  std::vector<IToken> i_tokens; // finished siblings of the current level
+  ITokenArena arena;            // what tokenize_in_place hands out
+  ITokenArena *out{nullptr};    // where closed spans put their children
+  std::string_view curr_text; // contiguous run of inline_data
   size_t fmt_pos;                // char position where formatting started
-  size_t fmt_loc;                // line number where formatting started
   std::vector<size_t> fmt_stack; // for nested formatting
   size_t pos;
-  size_t loc;
+  size_t base_offset; // document offset of inline_data[0]
   State curr_state;
-  std::string inline_data;
+  std::string_view inline_data;
+  std::unique_ptr<ILexer> nested; // lexes the open span, made on first use
+  const ILexer *outer{nullptr};   // whose span this lexer is lexing
+  size_t escaped_at; // the last escaped char, it can't start a url
 
   /*=== Formatting Location ===*/
   void start_formatting();
-  size_t get_format_start_loc();
+  size_t get_format_start_offset();
   void end_formatting();
 
   /*=== Handling Children ===*/
-  /* When we're inside a formatting state (bold, italic, etc.), we should
-  recursively tokenize the content to handle nested formatting. */
-  std::vector<IToken> recursive_tokenize(const std::string &input,
-                                         size_t s_loc);
+  /* When we're inside a formatting state (bold, italic), the nested lexer is
+  fed every byte the span collects, so its children are ready when the span
+  closes instead of scanning the span a second time. The lexers of the open
+  spans form a stack; to each nested lexer its span is the whole input, so
+  its lookahead and advance stop where the outer lexer closes the span. */
+  void feed_nested(char c);
+  void start_nested(); // on the span starting at pos
+  ITokenRange close_nested();
+  ITokenRange store_siblings(); // i_tokens into the arena, as one run
+  bool span_ends_at(size_t q) const; // no byte from q on belongs to us
+  bool closes_at(size_t q) const;    // the open bold/italic span closes at q
+  size_t span_end_within(size_t p, size_t k) const;
 
   /*=== Processing Functions ===*/
+  /* bytes that can end a run of plain text, see takes_plain_run */
+  static constexpr std::string_view markers = "*/[{~\\:";
+  bool takes_plain_run() const;
+  void take_plain_run(size_t n);
+  inline void step(char c); // runs the handler of the current state
   void handle_normal_state(char c);
   void handle_bold_state(char c);
   void handle_italic_state(char c);
@@ -87,18 +159,29 @@ private:
   void handle_image_state(char c);
   void handle_verbatim_state(char c);
   void handle_escape_state(char c);
+  bool take_bare_url(); // at the ':' after a scheme name
+
+
+  /*=== URL Detection ===*/
+  /* A bare url starts with a scheme from url_scheme.h and is linked when the
+  lexer reaches its ':', the scheme name is then cut from the end of the
+  text run it was collected in. */
+  bool after_url_scheme() const;       // curr_text ends in "scheme:"
+  size_t bare_url_end(size_t q) const; // one past the url going on at q
 
   /*=== Helper Functions ===*/
-  void heat_the_engine(const std::string &input, size_t s_loc);
+  void heat_the_engine(std::string_view input, size_t s_offset);
+  size_t offset_of(std::string_view text); // of a slice of inline_data
 
-  bool end();
-  char peek();
-  char lookahead(size_t offset = 1);
-  void advance(size_t offset = 1);
+  inline bool end() const;
+  inline char peek() const;
+  inline char lookahead(size_t offset = 1) const;
+  inline void advance(size_t offset = 1);
 
-  void add_token(InlineTokenType type,
-                 std::optional<std::string> content = std::nullopt,
-                 std::optional<std::string> url = std::nullopt);
+  void add_token(InlineTokenType type, size_t offset,
+                 std::optional<std::string_view> content = std::nullopt,
+                 std::optional<std::string_view> url = std::nullopt);
+  void extend_current_text(size_t n = 1);
   void finalize_current_text();
 };
 
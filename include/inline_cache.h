@@ -0,0 +1,59 @@
+#ifndef INLINE_CACHE_H
+#define INLINE_CACHE_H
+
+#include "i_lexer.h"
+#include <cstddef>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/*
+Rules:
+- class and struct will be named in PascalCase
+- class member functions and members will be named in snake_case
+*/
+
+/*
+ * Bounded LRU cache of inline tokens, keyed by block text.
+ * Exported wikis repeat the same footers, list items and template paragraphs
+ * over and over, on a hit the block is not tokenized again.
+ * - an entry owns a copy of its text, the cached tokens are views into that
+ *   copy and their offsets count from 0, the caller adds the block's offset
+ * - the least recently used entry is dropped once capacity is reached
+ * - capacity 0 turns the cache off, every lookup is a miss that hands out
+ *   the lexer's own arena
+ */
+class InlineCache {
+public:
+  explicit InlineCache(size_t capacity = 0) : capacity(capacity) {}
+
+  /* tokens of text, from the cache or made by lexer on a miss; valid until the
+  next lookup */
+  const ITokenArena &tokenize(std::string_view text, ILexer &lexer);
+
+  void set_capacity(size_t n); // drops entries above n
+  void clear();
+
+  size_t get_capacity() const { return capacity; }
+  size_t size() const { return entries.size(); }
+  size_t hits() const { return hit_count; }
+  size_t misses() const { return miss_count; }
+
+private:
+  struct Entry {
+    std::string text;
+    ITokenArena tokens;
+  };
+
+  size_t capacity;
+  std::list<Entry> entries; // most recently used first, nodes never move
+  std::unordered_map<std::string_view, std::list<Entry>::iterator>
+      index; // keys are views of Entry::text
+  size_t hit_count{0};
+  size_t miss_count{0};
+
+  void evict_to(size_t n);
+};
+
+#endif //! INLINE_CACHE_H
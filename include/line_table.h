@@ -0,0 +1,38 @@
+#ifndef LINE_TABLE_H
+#define LINE_TABLE_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+/*
+Rules:
+- class and struct will be named in PascalCase
+- class member functions and members will be named in snake_case
+*/
+
+/* 1 based line and column (in bytes) of a byte offset */
+struct LinePos {
+  size_t line;
+  size_t column;
+};
+
+/*
+ * Start offsets of every line of a document, built with one SIMD newline scan.
+ * Tokens and nodes only keep byte offsets, line and column are looked up here
+ * by binary search when somebody asks for them.
+ */
+class LineTable {
+public:
+  LineTable() = default;
+  explicit LineTable(std::string_view data);
+
+  LinePos position(size_t offset) const;
+  size_t line(size_t offset) const;
+  size_t line_count() const;
+
+private:
+  std::vector<size_t> starts{0}; // starts[i] is the offset of line i + 1
+};
+
+#endif //! LINE_TABLE_H
@@ -1,10 +1,18 @@
 #ifndef MIGR_H
 #define MIGR_H
 
+#include "string_pool.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <memory>
+#include <ranges>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 /*
@@ -13,7 +21,7 @@ Rules:
 - class member functions and members will be named in snake_case
 */
 
-enum class MIGRNodeType {
+enum class MIGRNodeType : uint8_t {
   /* structural */
   DOCUMENT_ROOT,
   HEADING,
@@ -41,6 +49,8 @@ enum class MIGRNodeType {
   FOOTNOTE, // todo: for future
   COMMENT,  // todo: for future
 };
+inline constexpr size_t node_type_count =
+    static_cast<size_t>(MIGRNodeType::COMMENT) + 1;
 
 enum class MIGREdgeType {
   STRUCTURAL_CHILD, // note: not used but keep for future serailzation format
@@ -50,50 +60,307 @@ enum class MIGREdgeType {
   TAG_RELATION,
 };
 
-class MIGRNode : public std::enable_shared_from_this<MIGRNode> {
+enum class LinkType : uint8_t {
+  NONE,
+  INTERNAL,
+  EXTERNAL, // http:// or https://
+};
+
+/*
+ * Attributes of a node, typed instead of a string map. A node only ever has
+ * a few: heading level, link/image url, reference target and link type, tag
+ * name. url, target and tag name never meet on one node, they share ref,
+ * interned in the layer's StringPool. Other keys go to extra, a small flat
+ * list.
+ */
+struct NodeAttrs {
+  int level{0}; // heading level, 0 = none
+  LinkType link_type{LinkType::NONE};
+  InternedStr ref; // see MIGRNode::ref_key
+  std::vector<std::pair<std::string, std::string>> extra;
+};
+
+/* identity of a node in every layer, handed out from 1 up, 0 is no node.
+"node_N" is only its printed and JSON form */
+using NodeId = uint32_t;
+inline constexpr NodeId no_node = 0;
+
+/* nodes are owned by the NodeArena of their layer, everything else (children,
+parent, layer maps, query results) holds plain pointers into it */
+class MIGRNode {
 public:
-  std::string id_;
+  NodeId id_;
   MIGRNodeType type_;
   std::string content_;
-  std::unordered_map<std::string, std::string> metadata_;
-  size_t loc_;
+  NodeAttrs attrs_;
+  size_t offset_; // byte offset in the source, see StructuralLayer::position
 
   /* structural edges (tree) */
-  std::vector<std::shared_ptr<MIGRNode>> children_;
-  std::weak_ptr<MIGRNode> parent_;
+  std::vector<MIGRNode *> children_;
+  MIGRNode *parent_{nullptr};
 
   /* versioning */
   size_t version_{0};
-  std::string content_hash_;
+  uint64_t content_hash_{0}; // hash64 of type and content, stable across runs
 
   MIGRNode(MIGRNodeType type, const std::string &c = "");
 
   /* core operations */
-  void add_child(std::shared_ptr<MIGRNode> child);
-  void remove_child(const std::string &child_id);
-  std::shared_ptr<MIGRNode> find_child(const std::string &id);
+  void add_child(MIGRNode *child);
+  void remove_child(NodeId child_id);
+  MIGRNode *find_child(NodeId id);
   void update_content(const std::string &new_content);
+  /* Merkle hash of the node (type, content, attributes) and its subtree,
+  recomputed on demand along the paths that changed */
+  uint64_t subtree_hash() const;
+  /* for edits made on the fields directly (attrs_, children_) */
+  void mark_dirty();
+  /* grows on every mark_dirty of any node, columns built before are stale */
+  static uint64_t edits() { return edits_; }
+
+  /* attributes by their metadata key, as they are printed and serialized */
+  void set_attr(std::string_view key, std::string value, StringPool &pool);
+  bool has_attrs() const;
+  /* calls f(key, value) for every attribute that is set, as string_views */
+  template <typename F> void for_each_attr(F &&f) const {
+    using sv = std::string_view;
+    if (attrs_.level > 0) {
+      f(sv("level"), sv(std::to_string(attrs_.level)));
+    }
+    if (!attrs_.ref.empty()) {
+      f(ref_key(type_), attrs_.ref.view());
+    }
+    if (attrs_.link_type != LinkType::NONE) {
+      f(sv("link_type"), link_type_string(attrs_.link_type));
+    }
+    for (const auto &[k, v] : attrs_.extra) {
+      f(sv(k), sv(v));
+    }
+  }
+  /* the key attrs_.ref stands for on a node of type, "" if none */
+  static std::string_view ref_key(MIGRNodeType type);
+  static std::string_view link_type_string(LinkType type);
 
   /* utility */
   std::string to_string() const;
   void print_tree(int depth = 0) const;
+  static std::string id_string(NodeId id);          // "node_N"
+  /* no_node if malformed, CNError if the number does not fit a NodeId */
+  static NodeId parse_id(std::string_view id_str);
+  /* ids made from now on are above id, e.g. one read from a file */
+  static void reserve_id(NodeId id);
 
 private:
+  mutable uint64_t subtree_hash_{0};
+  mutable bool subtree_dirty_{true}; // then so are all its ancestors
+
   void generate_id();
   void update_hash();
-  static size_t next_id_;
+  static NodeId next_id_;
+  static uint64_t edits_;
+};
+
+/*
+ * Node storage of a layer. Nodes are made in place in fixed chunks that never
+ * move, so their pointers stay valid until clear(), which frees the whole
+ * document in one go instead of node by node through refcounts.
+ */
+class NodeArena {
+public:
+  NodeArena() = default;
+  NodeArena(const NodeArena &) = delete; // nodes point at each other
+  NodeArena &operator=(const NodeArena &) = delete;
+
+  template <typename... Args> MIGRNode *make(Args &&...args) {
+    return &nodes.emplace_back(std::forward<Args>(args)...);
+  }
+  void clear() { nodes.clear(); }
+  size_t size() const { return nodes.size(); } // removed nodes included
+
+private:
+  std::deque<MIGRNode> nodes;
+};
+
+/*
+ * Values by NodeId, stored in a vector indexed by id, so a lookup is an index
+ * instead of hashing a string. Ids come from one counter and nodes of a layer
+ * are made close together, the vector starts at the smallest id it has seen.
+ * Ids read from a file can be far apart; once the vector would be mostly
+ * holes the map turns sparse: slots packed in id order with a sorted key
+ * each, a lookup is a binary search. A slot holding T{} counts as empty
+ * (null node, no edges).
+ */
+template <typename T> class NodeMap {
+public:
+  /* slot of id, made (empty) if missing */
+  T &operator[](NodeId id) {
+    if (!sparse && !slots.empty()) {
+      size_t span = std::max<NodeId>(id, base + (slots.size() - 1)) -
+                    std::min(id, base) + 1;
+      if (span > 2 * used + max_holes) {
+        to_sparse();
+      }
+    }
+    if (sparse) {
+      auto it = std::ranges::lower_bound(keys, id);
+      size_t i = it - keys.begin();
+      if (it == keys.end() || *it != id) {
+        keys.insert(it, id);
+        slots.insert(slots.begin() + i, T{});
+        ++used;
+      }
+      return slots[i];
+    }
+    if (slots.empty()) {
+      base = id;
+    } else if (id < base) {
+      slots.insert(slots.begin(), base - id, T{});
+      base = id;
+    }
+    if (id - base >= slots.size()) {
+      slots.resize(id - base + 1);
+    }
+    if (slots[id - base] == T{}) {
+      ++used;
+    }
+    return slots[id - base];
+  }
+
+  /* null if id has no slot or an empty one */
+  const T *find(NodeId id) const {
+    size_t i = slot_of(id);
+    if (i == npos || slots[i] == T{}) {
+      return nullptr;
+    }
+    return &slots[i];
+  }
+  bool contains(NodeId id) const { return find(id) != nullptr; }
+
+  void erase(NodeId id) {
+    size_t i = slot_of(id);
+    if (i != npos) {
+      slots[i] = T{};
+    }
+  }
+  void clear() {
+    slots.clear();
+    keys.clear();
+    base = 0;
+    used = 0;
+    sparse = false;
+  }
+
+  /* non empty slots, a scan */
+  size_t size() const { return std::ranges::distance(values()); }
+
+  /* non empty values in id order */
+  auto values() const {
+    return slots | std::views::filter([](const T &v) { return v != T{}; });
+  }
+  /* calls f(id, value) for non empty slots in id order */
+  template <typename F> void for_each(F &&f) const {
+    for (size_t i{0}; i < slots.size(); ++i) {
+      if (slots[i] != T{}) {
+        f(sparse ? keys[i] : static_cast<NodeId>(base + i), slots[i]);
+      }
+    }
+  }
+
+private:
+  static constexpr size_t npos = SIZE_MAX;
+  static constexpr size_t max_holes = 1024; // before the map turns sparse
+
+  std::vector<T> slots;
+  std::vector<NodeId> keys; // id of each slot, sparse only
+  NodeId base{0};           // id of slots[0], dense only
+  size_t used{0};           // slots handed out, an upper bound on non empty
+  bool sparse{false};
+
+  size_t slot_of(NodeId id) const {
+    if (sparse) {
+      auto it = std::ranges::lower_bound(keys, id);
+      return it != keys.end() && *it == id ? size_t(it - keys.begin()) : npos;
+    }
+    return id >= base && id - base < slots.size() ? id - base : npos;
+  }
+
+  /* keeps the non empty slots, each with its id */
+  void to_sparse() {
+    std::vector<T> packed;
+    for (size_t i{0}; i < slots.size(); ++i) {
+      if (slots[i] != T{}) {
+        keys.push_back(static_cast<NodeId>(base + i));
+        packed.push_back(std::move(slots[i]));
+      }
+    }
+    slots = std::move(packed);
+    used = slots.size();
+    sparse = true;
+  }
+};
+
+/*
+ * Columnar copy of a layer's nodes for scans: row i of every array describes
+ * the same node, so a type or offset filter walks a few packed arrays instead
+ * of chasing node pointers. Tree links are rows, npos_row where there is none.
+ * Built in one pass by the layer when a scan needs it after a node was added
+ * or removed, or after any node was edited (MIGRNode::edits moved): content
+ * views into a node whose content_ was replaced would dangle.
+ */
+struct NodeColumns {
+  static constexpr uint32_t npos_row = UINT32_MAX;
+
+  std::vector<NodeId> id;
+  std::vector<MIGRNodeType> type;
+  std::vector<size_t> offset;
+  std::vector<uint32_t> parent;
+  std::vector<uint32_t> first_child;
+  std::vector<uint32_t> next_sibling;
+  std::vector<std::string_view> content; // views of the nodes' content_
+  std::vector<MIGRNode *> node;          // metadata and the rest, by pointer
+  uint64_t edits{0};                     // MIGRNode::edits() when built
+
+  void build(const NodeMap<MIGRNode *> &nodes);
+  void clear();
+  size_t size() const { return id.size(); }
+
+  /* rows of type whose offset is in [begin, end) */
+  std::vector<uint32_t> rows_of(MIGRNodeType t, size_t begin = 0,
+                                size_t end = SIZE_MAX) const;
+};
+
+/*
+ * Posting list of every node type: the nodes of a layer by type, in id order.
+ * The layer keeps it in add_node/remove_node, so a type question reads one
+ * list instead of filtering every node. Ids mostly grow with insertion, an
+ * add is usually an append; a remove is a binary search and an erase.
+ */
+class NodeTypeIndex {
+public:
+  void add(MIGRNode *node);
+  void remove(const MIGRNode *node);
+  void clear();
+  void build(const NodeMap<MIGRNode *> &nodes); // from scratch, e.g. on load
+
+  std::span<MIGRNode *const> of(MIGRNodeType type) const {
+    return lists[static_cast<size_t>(type)];
+  }
+  size_t count(MIGRNodeType type) const { return of(type).size(); }
+  size_t size() const; // nodes of every type, one add per type
+
+private:
+  std::array<std::vector<MIGRNode *>, node_type_count> lists;
 };
 
 /* MIGRGraphLayer: Interface for Layer Management */
 class MIGRGraphLayer {
 public:
   virtual ~MIGRGraphLayer() = default;
-  virtual void add_node(std::shared_ptr<MIGRNode> node) = 0;
-  virtual void remove_node(const std::string &node_id) = 0;
-  virtual std::vector<std::shared_ptr<MIGRNode>>
+  virtual void add_node(MIGRNode *node) = 0;
+  virtual void remove_node(NodeId node_id) = 0;
+  virtual std::vector<MIGRNode *>
   query_nodes(std::function<bool(const MIGRNode &)> predicate) const = 0;
-  virtual std::vector<std::shared_ptr<MIGRNode>>
-  get_neighbours(const std::string &node_id) const = 0;
+  virtual std::vector<MIGRNode *> get_neighbours(NodeId node_id) const = 0;
   virtual void serialize(std::ostream &out) const = 0;
   virtual void deserialize(std::istream &in) = 0;
 };
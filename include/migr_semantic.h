@@ -5,8 +5,8 @@
 #include "migr_structural.h"
 
 struct SemanticEdge {
-  std::string source_id;
-  std::string target_id;
+  NodeId source_id;
+  NodeId target_id;
   MIGREdgeType edge_type;
   std::string relation_label; // "references", "tagged_with"
 };
@@ -20,68 +20,142 @@ Rules:
 class SemanticLayer : public MIGRGraphLayer {
 public:
   SemanticLayer() = default;
+  SemanticLayer(const SemanticLayer &) = delete; // owns its nodes
+  SemanticLayer &operator=(const SemanticLayer &) = delete;
 
   /* MIGR Graph Interface */
-  void add_node(std::shared_ptr<MIGRNode> node) override;
-  void remove_node(const std::string &node_id) override;
-  std::vector<std::shared_ptr<MIGRNode>>
+  void add_node(MIGRNode *node) override;
+  void remove_node(NodeId node_id) override;
+  std::vector<MIGRNode *>
   query_nodes(std::function<bool(const MIGRNode &)> predicate) const override;
-  virtual std::vector<std::shared_ptr<MIGRNode>>
-  get_neighbours(const std::string &node_id) const override;
+  virtual std::vector<MIGRNode *> get_neighbours(NodeId node_id) const override;
   void serialize(std::ostream &out) const override;
   void deserialize(std::istream &in) override;
 
+  /* columnar view of the nodes, rebuilt on first use after a change */
+  const NodeColumns &columns() const;
+  std::vector<MIGRNode *> scan(MIGRNodeType type) const; // over columns()
+  /* nodes of type in id order, kept up to date by add_node/remove_node */
+  std::span<MIGRNode *const> nodes_of_type(MIGRNodeType type) const {
+    return by_type_.of(type);
+  }
+  /* query_nodes for any callable, without std::function */
+  template <typename Pred>
+    requires std::predicate<Pred &, const MIGRNode &>
+  std::vector<MIGRNode *> query_nodes(Pred &&predicate) const {
+    std::vector<MIGRNode *> results;
+    for (MIGRNode *node : semantic_nodes_.values()) {
+      if (predicate(std::as_const(*node))) {
+        results.push_back(node);
+      }
+    }
+    return results;
+  }
+
   /* Semantic Operations */
   void extract_semantics(const StructuralLayer &structural);
-  void add_semantic_edge(const std::shared_ptr<MIGRNode> &source,
-                         const std::shared_ptr<MIGRNode> &target,
+  void add_semantic_edge(MIGRNode *source, MIGRNode *target,
                          MIGREdgeType edge_type,
                          const std::string &relation_label = "");
-  std::vector<std::shared_ptr<MIGRNode>>
-  find_backlinks(const std::string &target_id) const;
-  std::vector<std::shared_ptr<MIGRNode>>
-  search_tag(const std::string &tag) const;
-  std::vector<std::shared_ptr<MIGRNode>>
+  std::vector<MIGRNode *> find_backlinks(NodeId target_id) const;
+  std::vector<MIGRNode *> search_tag(const std::string &tag) const;
+  std::vector<MIGRNode *>
   find_all_links_to_target(const std::string &target_name) const;
 
   /* Edge Query Operations */
-  std::vector<std::shared_ptr<MIGRNode>>
-  get_semantic_targets(const std::string &source_id) const;
-  std::vector<std::shared_ptr<MIGRNode>>
-  get_semantic_sources(const std::string &target_id) const;
-  std::vector<SemanticEdge>
-  get_edges_from_node(const std::string &node_id) const;
-  std::vector<SemanticEdge> get_edges_to_node(const std::string &node_id) const;
+  std::vector<MIGRNode *> get_semantic_targets(NodeId source_id) const;
+  std::vector<MIGRNode *> get_semantic_sources(NodeId target_id) const;
+  std::vector<SemanticEdge> get_edges_from_node(NodeId node_id) const;
+  std::vector<SemanticEdge> get_edges_to_node(NodeId node_id) const;
+
+  /* Lazy Queries */
+  /* Views over the layer's own storage, walked as they are read: nothing is
+  copied, so a caller after the first few hits or a count (std::views::take,
+  std::ranges::distance) pays for just that much. They hand out node pointers
+  and edge references, valid until the layer changes. */
+  template <typename Pred>
+    requires std::predicate<Pred &, const MIGRNode &>
+  auto query_view(Pred &&predicate) const {
+    return semantic_nodes_.values() |
+           std::views::filter([p = std::forward<Pred>(predicate)](
+                                  MIGRNode *n) mutable {
+             return p(std::as_const(*n));
+           });
+  }
+  auto edges_from_view(NodeId node_id) const {
+    return edge_indices(outgoing_edge_index_, node_id) |
+           std::views::transform(
+               [this](size_t i) -> const SemanticEdge & { return edges_[i]; });
+  }
+  auto edges_to_view(NodeId node_id) const {
+    return edge_indices(incoming_edge_index_, node_id) |
+           std::views::transform(
+               [this](size_t i) -> const SemanticEdge & { return edges_[i]; });
+  }
+  auto semantic_targets_view(NodeId source_id) const {
+    return edges_from_view(source_id) |
+           std::views::transform([this](const SemanticEdge &e) {
+             return node_or_null(e.target_id);
+           }) |
+           std::views::filter([](MIGRNode *n) { return n != nullptr; });
+  }
+  auto semantic_sources_view(NodeId target_id) const {
+    return edges_to_view(target_id) |
+           std::views::transform([this](const SemanticEdge &e) {
+             return node_or_null(e.source_id);
+           }) |
+           std::views::filter([](MIGRNode *n) { return n != nullptr; });
+  }
+  auto backlinks_view(NodeId target_id) const {
+    return semantic_sources_view(target_id);
+  }
+  auto neighbours_view(NodeId node_id) const {
+    return semantic_targets_view(node_id);
+  }
 
   /* for debuggin' */
   void print_semantic_info(bool detailed = false) const;
 
 private:
-  std::unordered_map<std::string, std::shared_ptr<MIGRNode>>
-      semantic_nodes_;              // [id : node]
-  std::vector<SemanticEdge> edges_; // efficient querying
+  /* every node lives in arena_: references and tags, and copies of the
+  StructuralLayer's LINK nodes (same ids, no tree links), so the layer stays
+  valid when the StructuralLayer is rebuilt, reloaded or destroyed */
+  NodeArena arena_;
+  /* targets and tag names, the StructuralLayer's pool after extraction */
+  std::shared_ptr<StringPool> strings_ = std::make_shared<StringPool>();
+  NodeMap<MIGRNode *> semantic_nodes_; // [id : node]
+  NodeTypeIndex by_type_;              // [type : nodes]
+  std::vector<SemanticEdge> edges_;    // efficient querying
+  mutable NodeColumns columns_;
+  mutable bool columns_dirty_{true};
 
-  std::unordered_map<std::string, std::vector<size_t>>
-      outgoing_edge_index_; // [node id : edge idx]
-  std::unordered_map<std::string, std::vector<size_t>>
-      incoming_edge_index_; // [node id : edge idx]
+  NodeMap<std::vector<size_t>> outgoing_edge_index_; // [node id : edge idx]
+  NodeMap<std::vector<size_t>> incoming_edge_index_; // [node id : edge idx]
 
   /* Cache for reference nodes and tag nodes */
-  std::unordered_map<std::string, std::string>
-      reference_cache_;                                    // [target : node_id]
-  std::unordered_map<std::string, std::string> tag_cache_; // [tag_name : id]
+  std::unordered_map<InternedStr, NodeId> reference_cache_; // [target : id]
+  std::unordered_map<InternedStr, NodeId> tag_cache_;       // [tag_name : id]
 
   /* Helpers */
   void reset();
-  void extract_links(std::shared_ptr<MIGRNode> node);
-  void extract_tags(std::shared_ptr<MIGRNode> node);
+  MIGRNode *node_or_null(NodeId id) const {
+    auto node = semantic_nodes_.find(id);
+    return node ? *node : nullptr;
+  }
+  /* edge indexes of id in index, empty if it has none */
+  static std::span<const size_t>
+  edge_indices(const NodeMap<std::vector<size_t>> &index, NodeId id) {
+    auto idxs = index.find(id);
+    return idxs ? std::span<const size_t>(*idxs) : std::span<const size_t>();
+  }
+  void extract_links(MIGRNode *node);
+  void extract_tags(MIGRNode *node);
   void build_edge_indexes();
-  std::string classify_link_type(const std::string &target) const;
+  LinkType classify_link_type(std::string_view target) const;
 
   /* Node Management */
-  std::shared_ptr<MIGRNode>
-  get_or_create_reference_node(const std::string &target);
-  std::shared_ptr<MIGRNode> get_or_create_tag_node(const std::string &tag_name);
+  MIGRNode *get_or_create_reference_node(InternedStr target);
+  MIGRNode *get_or_create_tag_node(InternedStr tag_name);
 };
 
 #endif //! MIGR_SEMANTIC_H
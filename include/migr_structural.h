@@ -3,8 +3,11 @@
 
 #include "b_lexer.h"
 #include "error.h"
+#include "inline_cache.h"
 #include "migr.h"
+#include <concepts>
 #include <stack>
+#include <utility>
 
 /*
 Rules:
@@ -22,20 +25,98 @@ enum class RecoveryStrategy {
 class StructuralLayer : public MIGRGraphLayer {
 public:
   StructuralLayer();
+  StructuralLayer(const StructuralLayer &) = delete; // owns its nodes
+  StructuralLayer &operator=(const StructuralLayer &) = delete;
 
   /* from MIGRGraphLayer interface */
-  void add_node(std::shared_ptr<MIGRNode> node) override;
-  void remove_node(const std::string &node_id) override;
-  std::vector<std::shared_ptr<MIGRNode>>
+  void add_node(MIGRNode *node) override; // node made by make_node
+  void remove_node(NodeId node_id) override;
+  std::vector<MIGRNode *>
   query_nodes(std::function<bool(const MIGRNode &)> predicate) const override;
-  virtual std::vector<std::shared_ptr<MIGRNode>>
-  get_neighbours(const std::string &node_id) const override;
+  virtual std::vector<MIGRNode *> get_neighbours(NodeId node_id) const override;
   void serialize(std::ostream &out) const override;
   void deserialize(std::istream &in) override;
 
   /* core functionality */
-  void build_from_tokens(const std::vector<BToken> &tokens);
-  std::shared_ptr<MIGRNode> get_root() const;
+  void build_from_tokens(const std::vector<BToken> &tokens,
+                         std::shared_ptr<const CreoleSource> source = nullptr);
+  void build_from_stream(BTokenSource &tokens,
+                         std::shared_ptr<const CreoleSource> source = nullptr);
+  MIGRNode *get_root() const;
+  /* columnar view of the nodes, rebuilt on first use after a change */
+  const NodeColumns &columns() const;
+  /* nodes of type starting in [begin, end), scanned over columns() */
+  std::vector<MIGRNode *> scan(MIGRNodeType type, size_t begin = 0,
+                               size_t end = SIZE_MAX) const;
+  /* nodes of type in id order, kept up to date by add_node/remove_node */
+  std::span<MIGRNode *const> nodes_of_type(MIGRNodeType type) const {
+    return by_type_.of(type);
+  }
+  /* query_nodes for any callable, called directly instead of through a
+  std::function; the second form only looks at nodes of type */
+  template <typename Pred>
+    requires std::predicate<Pred &, const MIGRNode &>
+  std::vector<MIGRNode *> query_nodes(Pred &&predicate) const {
+    std::vector<MIGRNode *> results;
+    for (MIGRNode *node : nodes_.values()) {
+      if (predicate(std::as_const(*node))) {
+        results.push_back(node);
+      }
+    }
+    return results;
+  }
+  template <typename Pred>
+    requires std::predicate<Pred &, const MIGRNode &>
+  std::vector<MIGRNode *> query_nodes(MIGRNodeType type,
+                                      Pred &&predicate) const {
+    std::vector<MIGRNode *> results;
+    for (MIGRNode *node : nodes_of_type(type)) {
+      if (predicate(std::as_const(*node))) {
+        results.push_back(node);
+      }
+    }
+    return results;
+  }
+  /* Lazy Queries */
+  /* views over the layer's storage, walked as they are read and valid until
+  the layer changes; see SemanticLayer's for the edge side */
+  template <typename Pred>
+    requires std::predicate<Pred &, const MIGRNode &>
+  auto query_view(Pred &&predicate) const {
+    return nodes_.values() |
+           std::views::filter([p = std::forward<Pred>(predicate)](
+                                  MIGRNode *n) mutable {
+             return p(std::as_const(*n));
+           });
+  }
+  template <typename Pred>
+    requires std::predicate<Pred &, const MIGRNode &>
+  auto query_view(MIGRNodeType type, Pred &&predicate) const {
+    return nodes_of_type(type) |
+           std::views::filter([p = std::forward<Pred>(predicate)](
+                                  MIGRNode *n) mutable {
+             return p(std::as_const(*n));
+           });
+  }
+  std::span<MIGRNode *const> neighbours_view(NodeId node_id) const {
+    auto node = nodes_.find(node_id);
+    return node ? std::span<MIGRNode *const>((*node)->children_)
+                : std::span<MIGRNode *const>();
+  }
+
+  /* a new node in the layer's arena, valid as long as the layer */
+  MIGRNode *make_node(MIGRNodeType type, const std::string &content = "");
+  LinePos position(const MIGRNode &node) const; // line/column of offset_
+
+  /* Inline Cache */
+  /* blocks with the same text share their inline tokens, 0 (default) is off */
+  void set_inline_cache_size(size_t n);
+  const InlineCache &get_inline_cache() const;
+
+  /* String Pool */
+  /* urls and other refs are interned here, shared with the SemanticLayer */
+  std::shared_ptr<StringPool> get_string_pool() const;
+  void set_string_pool(std::shared_ptr<StringPool> pool);
 
   /* Error Recovery */
   void set_recovery_stratgegy(RecoveryStrategy strategy);
@@ -46,17 +127,26 @@ public:
   void print_structural_info(bool detailed = false) const;
 
 private:
-  std::shared_ptr<MIGRNode> root_;
-  std::unordered_map<std::string, std::shared_ptr<MIGRNode>>
-      nodes_; // [id : node]
+  NodeArena arena_; // owns every node of the layer
+  std::shared_ptr<StringPool> strings_; // never null, outlives nodes' refs
+  MIGRNode *root_;
+  std::shared_ptr<const CreoleSource> source_; // for positions, may be null
+  NodeMap<MIGRNode *> nodes_;                  // [id : node]
+  NodeTypeIndex by_type_;                      // [type : nodes]
+  mutable NodeColumns columns_;
+  mutable bool columns_dirty_{true};
   RecoveryStrategy recovery_strategy_;
 
   /* parsing state */
-  std::stack<std::shared_ptr<MIGRNode>> parent_stack_;
-  std::stack<std::shared_ptr<MIGRNode>> list_stack_;
+  std::stack<MIGRNode *> parent_stack_;
+  std::stack<MIGRNode *> list_stack_;
   std::vector<MIGRError> errors_;
+  ILexer i_lexer_; // reused for the inline content of every block
+  InlineCache inline_cache_;
 
   /* Token Processing Helpers */
+  void process_token(const BToken &token, size_t i);
+  void finish_build();
   void process_heading_token(const BToken &token);
   void process_paragraph_token(const BToken &token);
   void process_ulist_token(const BToken &token);
@@ -73,10 +163,11 @@ private:
   bool in_list_context() const;
 
   /* inline processing */
-  void process_inline_content(std::shared_ptr<MIGRNode> parent,
-                              const std::string &content);
-  std::shared_ptr<MIGRNode>
-  convert_i_tokens_to_migr_node(const IToken &i_token);
+  void process_inline_content(MIGRNode *parent,
+                              const BToken &token);
+  MIGRNode *
+  convert_i_tokens_to_migr_node(const ITokenArena &arena,
+                                const IToken &i_token, size_t base = 0);
 
   /* Error Handling */
   void handle_error(const std::string &message, size_t line);
@@ -0,0 +1,31 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+/*
+Byte scanning core shared by the lexers.
+- every function works on the half open range [p, end)
+- SSE2/AVX2 implementations are picked once at startup from the cpu
+  features, other targets use the scalar fallback
+*/
+
+/* first byte equal to any char of set (at most 8 chars), or end */
+const char *find_first_of(const char *p, const char *end, std::string_view set);
+
+/* first '\n', or end */
+const char *find_newline(const char *p, const char *end);
+
+/* number of '\n' bytes in the range */
+size_t count_newlines(const char *p, const char *end);
+
+/* appends base + i + 1 for every '\n' at p[i], the lines starting after it */
+void line_starts(const char *p, const char *end, size_t base,
+                 std::vector<size_t> &out);
+
+/* name of the implementation in use, "avx2", "sse2" or "scalar" */
+const char *scan_backend();
+
+#endif //! SCAN_H
@@ -3,31 +3,32 @@
 
 #include "migr.h"
 #include "rapidjson/writer.h"
+#include <algorithm>
 
 using Writer = rapidjson::Writer<rapidjson::StringBuffer>;
 
 class SerialzationEngine {
 public:
   /* Node Serialzation */
-  static void write_node(Writer &w, const std::shared_ptr<MIGRNode> &node) {
+  static void write_node(Writer &w, const MIGRNode *node) {
     if (!node) {
       return;
     }
 
-    w.Key(node->id_.c_str());
+    w.Key(MIGRNode::id_string(node->id_).c_str());
     w.StartObject();
     w.Key("type");
     w.Int(static_cast<int>(node->type_));
     w.Key("content");
     w.String(node->content_.c_str());
 
-    if (!node->metadata_.empty()) {
+    if (node->has_attrs()) {
       w.Key("metadata");
       w.StartObject();
-      for (const auto &[k, v] : node->metadata_) {
-        w.Key(k.c_str());
-        w.String(v.c_str());
-      }
+      node->for_each_attr([&](std::string_view k, std::string_view v) {
+        w.Key(k.data(), k.size());
+        w.String(v.data(), v.size());
+      });
       w.EndObject();
     }
 
@@ -35,25 +36,24 @@ public:
     w.StartArray();
     for (const auto &child : node->children_) {
       if (child)
-        w.String(child->id_.c_str());
+        w.String(MIGRNode::id_string(child->id_).c_str());
     }
     w.EndArray();
 
-    if (auto parent = node->parent_.lock()) {
+    if (const MIGRNode *parent = node->parent_) {
       w.Key("parent");
-      w.String(parent->id_.c_str());
+      w.String(MIGRNode::id_string(parent->id_).c_str());
     }
 
     w.EndObject();
   }
 
   /* Node Map Serialzation */
-  static void write_nodes(
-      Writer &w,
-      const std::unordered_map<std::string, std::shared_ptr<MIGRNode>> &nodes) {
+  static void write_nodes(Writer &w,
+                          const NodeMap<MIGRNode *> &nodes) {
     w.Key("nodes");
     w.StartObject();
-    for (const auto &[id, node] : nodes) {
+    for (const auto &node : nodes.values()) {
       write_node(w, node);
     }
     w.EndObject();
@@ -64,9 +64,9 @@ public:
   static void write_edge(Writer &w, const EdgeType &edge) {
     w.StartObject();
     w.Key("source");
-    w.String(edge.source_id.c_str());
+    w.String(MIGRNode::id_string(edge.source_id).c_str());
     w.Key("target");
-    w.String(edge.target_id.c_str());
+    w.String(MIGRNode::id_string(edge.target_id).c_str());
     w.Key("type");
     w.Int(static_cast<int>(edge.edge_type));
     if constexpr (requires { edge.relation_label; }) {
@@ -88,32 +88,38 @@ public:
     w.EndArray();
   }
 
-  /* String-To-String Map */
-  static void
-  write_map(Writer &w, const char *key,
-            const std::unordered_map<std::string, std::string> &map) {
+  /* String-To-Id Map (for caches), in key order: the map hashes handles,
+  whose order changes from run to run */
+  static void write_map(Writer &w, const char *key,
+                        const std::unordered_map<InternedStr, NodeId> &map) {
+    std::vector<std::pair<std::string_view, NodeId>> sorted;
+    sorted.reserve(map.size());
+    for (const auto &[k, v] : map) {
+      sorted.emplace_back(k.view(), v);
+    }
+    std::sort(sorted.begin(), sorted.end());
+
     w.Key(key);
     w.StartObject();
-    for (const auto &[k, v] : map) {
-      w.Key(k.c_str());
-      w.String(v.c_str());
+    for (const auto &[name, v] : sorted) {
+      w.Key(name.data(), static_cast<rapidjson::SizeType>(name.size()));
+      w.String(MIGRNode::id_string(v).c_str());
     }
     w.EndObject();
   }
 
-  /* String-To-Vector Map (for indexes) */
-  static void
-  write_index(Writer &w, const char *key,
-              const std::unordered_map<std::string, std::vector<size_t>> &idx) {
+  /* Id-To-Vector Map (for indexes) */
+  static void write_index(Writer &w, const char *key,
+                          const NodeMap<std::vector<size_t>> &idx) {
     w.Key(key);
     w.StartObject();
-    for (const auto &[id, vec] : idx) {
-      w.Key(id.c_str());
+    idx.for_each([&](NodeId id, const std::vector<size_t> &vec) {
+      w.Key(MIGRNode::id_string(id).c_str());
       w.StartArray();
       for (size_t i : vec)
         w.Uint64(i);
       w.EndArray();
-    }
+    });
     w.EndObject();
   }
 };
@@ -0,0 +1,79 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+Rules:
+- class and struct will be named in PascalCase
+- class member functions and members will be named in snake_case
+*/
+
+/*
+ * Handle of a string in a StringPool, one pointer wide. Each distinct string
+ * is stored once per pool, so two handles from the same pool are equal exactly
+ * when their strings are, and comparing them is a pointer compare. The default
+ * handle is the empty string.
+ */
+class InternedStr {
+public:
+  InternedStr() = default;
+  std::string_view view() const { return entry ? *entry : std::string_view(); }
+  bool empty() const { return !entry; }
+  bool operator==(const InternedStr &) const = default;
+
+private:
+  friend class StringPool;
+  friend struct std::hash<InternedStr>;
+  explicit InternedStr(const std::string_view *entry) : entry(entry) {}
+  const std::string_view *entry{nullptr};
+};
+
+template <> struct std::hash<InternedStr> {
+  size_t operator()(const InternedStr &s) const noexcept {
+    return std::hash<const void *>{}(s.entry);
+  }
+};
+
+/*
+ * Append-only string interning pool.
+ * - bytes go to fixed chunks that never move, the table maps text to its
+ *   entry, so handles stay valid as long as the pool
+ * - layers share one through a shared_ptr, per document or for a whole corpus
+ * - nothing is ever removed, a pool lives as long as its longest user
+ */
+class StringPool {
+public:
+  StringPool() = default;
+  StringPool(const StringPool &) = delete; // handles point into it
+  StringPool &operator=(const StringPool &) = delete;
+
+  InternedStr intern(std::string_view s);
+  InternedStr find(std::string_view s) const; // empty if s is not in the pool
+
+  size_t size() const { return entries.size(); } // distinct strings
+  size_t bytes() const { return used; }          // their total length
+
+private:
+  struct Hash {
+    size_t operator()(std::string_view s) const;
+  };
+
+  static constexpr size_t chunk_size = 16 * 1024;
+  std::vector<std::unique_ptr<char[]>> chunks;
+  char *chunk_pos{nullptr};
+  size_t chunk_left{0};
+  size_t used{0};
+  std::deque<std::string_view> entries; // never move, handles point at them
+  std::unordered_map<std::string_view, const std::string_view *, Hash> index;
+
+  std::string_view store(std::string_view s);
+};
+
+#endif //! STRING_POOL_H
@@ -0,0 +1,51 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/*
+Rules:
+- class and struct will be named in PascalCase
+- class member functions and members will be named in snake_case
+*/
+
+/*
+Event tracing for the lexers and the structural layer.
+- TRACE(level, msg, arg) records an event if level is at most CN_TRACE_LEVEL,
+  events above it are discarded at compile time and cost nothing
+- events go to a fixed ring buffer in memory: a relaxed fetch_add and three
+  stores, no lock, no formatting, no i/o, so the default level stays on in
+  release builds
+- msg must be a string literal, only the pointer is kept
+- the ring holds the last trace_capacity events, trace_dump prints them oldest
+  first (main does with -v, and with the tail of it on errors)
+*/
+
+enum class TraceLevel : int {
+  OFF,    // nothing
+  STAGE,  // once per stage of a document, the _V_ messages
+  BLOCK,  // once per block or node
+  INLINE, // per inline token and per byte of the inline lexer
+};
+
+#ifndef CN_TRACE_LEVEL
+#define CN_TRACE_LEVEL 2 // BLOCK
+#endif
+
+inline constexpr TraceLevel trace_level =
+    static_cast<TraceLevel>(CN_TRACE_LEVEL);
+inline constexpr size_t trace_capacity = 1 << 14; // events, a power of two
+
+void trace_event(const char *msg, uint64_t arg);
+void trace_dump(std::ostream &out, size_t last = trace_capacity);
+
+#define TRACE(level, msg, arg)                                                 \
+  do {                                                                         \
+    if constexpr (TraceLevel::level <= trace_level) {                          \
+      trace_event(msg, static_cast<uint64_t>(arg));                            \
+    }                                                                          \
+  } while (0)
+
+#endif //! TRACE_H
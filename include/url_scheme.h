@@ -0,0 +1,82 @@
+#ifndef URL_SCHEME_H
+#define URL_SCHEME_H
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+/*
+Rules:
+- class and struct will be named in PascalCase
+- class member functions and members will be named in snake_case
+*/
+
+/*
+URL schemes the inline lexer recognizes in running text.
+- add a scheme to url_schemes to have it recognized, names in lowercase and
+  without the ':'
+- slashes schemes only start a url when "//" follows the ':', so a stray
+  "file:" in a sentence stays text
+- matching is case-insensitive and done in place on the text before the ':',
+  all of it is constexpr and nothing is copied
+*/
+struct UrlScheme {
+  std::string_view name;
+  bool slashes;
+};
+
+inline constexpr UrlScheme url_schemes[] = {
+    {"http", true}, {"https", true}, {"ftp", true},  {"ftps", true},
+    {"sftp", true}, {"file", true},  {"irc", true},  {"mailto", false},
+};
+
+constexpr char ascii_lower(char c) {
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+namespace url_scheme_detail {
+/* last letters of all scheme names, rejects most text after one lookup */
+constexpr std::array<bool, 256> make_last_letters() {
+  std::array<bool, 256> set{};
+  for (const auto &s : url_schemes) {
+    set[static_cast<unsigned char>(s.name.back())] = true;
+  }
+  return set;
+}
+inline constexpr std::array<bool, 256> last_letters = make_last_letters();
+} // namespace url_scheme_detail
+
+/* the scheme text ends with, or nullptr */
+constexpr const UrlScheme *scheme_at_end(std::string_view text) {
+  if (text.empty() ||
+      !url_scheme_detail::last_letters[static_cast<unsigned char>(
+          ascii_lower(text.back()))]) {
+    return nullptr;
+  }
+  const UrlScheme *best = nullptr; // the longest, "sftp" and not "ftp"
+  size_t best_size{0};
+  for (const auto &s : url_schemes) {
+    if (s.name.size() > text.size() || s.name.size() <= best_size) {
+      continue;
+    }
+    size_t start = text.size() - s.name.size();
+    size_t i{0};
+    while (i < s.name.size() && ascii_lower(text[start + i]) == s.name[i]) {
+      ++i;
+    }
+    if (i == s.name.size()) {
+      best = &s;
+      best_size = s.name.size();
+    }
+  }
+  return best;
+}
+
+static_assert(scheme_at_end("see HTTPS")->name == "https");
+static_assert(scheme_at_end("Ftp")->name == "ftp");
+static_assert(scheme_at_end("sftp")->name == "sftp");
+static_assert(scheme_at_end("mailto")->name == "mailto");
+static_assert(scheme_at_end("https ") == nullptr);
+static_assert(scheme_at_end("tp") == nullptr);
+
+#endif //! URL_SCHEME_H
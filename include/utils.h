@@ -2,9 +2,16 @@
 #define UTILS_H
 
 #include <string>
+#include <string_view>
+
+/* bounds of the -j and -c values parse_args accepts */
+inline constexpr size_t max_jobs = 256;
+inline constexpr size_t max_inline_cache = 1 << 20;
 
 struct Args {
   std::string filename;
+  size_t jobs{1}; // threads for block lexing, 1 to max_jobs
+  size_t inline_cache{0}; // block texts kept tokenized, 0 (default) = off
 };
 
 void usage(void);
@@ -13,5 +20,6 @@ Args parse_args(int argc, char *argv[]);
 std::string ltrim(const std::string &str);
 std::string rtrim(const std::string &str);
 std::string trim(const std::string &str);
+std::string_view trim_view(std::string_view str);
 
 #endif // !UTILS_H
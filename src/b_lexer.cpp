@@ -1,59 +1,404 @@
 #include "b_lexer.h"
 #include "error.h"
 #include "globals.h"
+#include "scan.h"
 #include "utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <thread>
 
-BLexer::BLexer(const std::string &filepath) : pos(0), loc(1) {
-  creole_data = read_creole_file(filepath);
+BLexer::BLexer(const std::string &filepath)
+    : BLexer(CreoleSource::open(filepath)) {}
+
+BLexer::BLexer(std::shared_ptr<const CreoleSource> source, size_t first_line)
+    : source(std::move(source)), pos(0), base(0), first_line(first_line),
+      block_start(0) {
+  creole_data = this->source->view();
   _V_ << " [BLexer] Creole data read." << std::endl;
 }
 
+BLexer::BLexer(std::shared_ptr<const CreoleSource> source,
+               std::string_view range, size_t first_line)
+    : source(std::move(source)), creole_data(range), pos(0),
+      base(this->source->offset_of(range)), first_line(first_line),
+      block_start(0) {}
+
 /*=== Publicaly Exposed Functions ===*/
 void BLexer::b_tokenize() {
   _V_ << " [BLexer] Block Tokenization Started." << std::endl;
+  if (!try_tokenize()) {
+    throw_error();
+  }
+  _V_ << " [BLexer] Block Tokenization Ended." << std::endl;
+}
+
+/*
+ * The exception-free core of b_tokenize. On an error the tokens lexed so far
+ * are kept and last_error() tells what went wrong.
+ */
+bool BLexer::try_tokenize() {
   while (!end()) {
-    if (is_whites()) {
-      while (!end() && is_whites()) {
-        advance();
-      }
-      tokens.push_back({BlockTokenType::NEWLINE, loc});
-      if (!end() && is_newline()) {
-        advance();
-      }
-      continue;
+    if (!lex_block()) {
+      return false;
     }
-    if (peek() == '=') {
-      read_heading();
-    } else if (peek() == '*') {
-      read_uli();
-    } else if (peek() == '#') {
-      read_oli();
-    } else if (peek() == '-') {
-      read_horizonalrule();
-    } else if (peek() == '{' && lookahead() == '{' && lookahead(2) == '{') {
-      read_verbatim();
-    } else if (is_newline()) {
-      read_blankline();
-    } else {
-      read_paragraph();
+  }
+  tokens.push_back({BlockTokenType::ENDOF, base + pos});
+  return true;
+}
+
+/*
+ * Tokenizes the document on n_threads cores (0 picks the hardware count).
+ * The input is cut at block boundaries into one chunk per thread and the
+ * chunks are lexed concurrently. Token offsets are offsets into the shared
+ * source, so stitching only concatenates the tokens in order. A chunk that
+ * ended inside a block (open
+ * verbatim, short rule, lexer error at the cut) is merged with the next one
+ * and lexed again, so the result is always the serial one.
+ */
+void BLexer::b_tokenize_parallel(size_t n_threads) {
+  if (n_threads == 0) {
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // below this there is not enough work to pay for the threads
+  constexpr size_t min_chunk = 1 << 20;
+  n_threads = std::min(n_threads, creole_data.size() / min_chunk);
+  if (n_threads <= 1 || pos != 0) {
+    b_tokenize();
+    return;
+  }
+  _V_ << " [BLexer] Parallel Block Tokenization Started on " << n_threads
+      << " threads." << std::endl;
+
+  // chunk edges, each one a block boundary
+  std::vector<size_t> edges{0};
+  for (size_t i{1}; i < n_threads; ++i) {
+    size_t cut = next_block_boundary(creole_data,
+                                     creole_data.size() / n_threads * i);
+    if (cut == std::string_view::npos) {
+      break;
+    }
+    if (cut > edges.back()) {
+      edges.push_back(cut);
     }
   }
-  tokens.push_back({BlockTokenType::ENDOF, loc});
-  _V_ << " [BLexer] Block Tokenization Ended." << std::endl;
+  edges.push_back(creole_data.size());
+  size_t n_chunks = edges.size() - 1;
+
+  struct Chunk {
+    std::unique_ptr<BLexer> lexer;
+    bool failed{false};
+  };
+  auto lex_chunk = [&](size_t first, size_t last) {
+    Chunk c;
+    c.lexer = std::unique_ptr<BLexer>(new BLexer(
+        source, creole_data.substr(edges[first], edges[last] - edges[first]),
+        first_line));
+    c.failed = !c.lexer->try_tokenize();
+    return c;
+  };
+
+  std::vector<Chunk> chunks(n_chunks);
+  std::vector<std::thread> workers;
+  for (size_t i{0}; i < n_chunks; ++i) {
+    workers.emplace_back([&, i] { chunks[i] = lex_chunk(i, i + 1); });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+
+  // stitch in order, re-lexing across a cut that fell inside a block
+  for (size_t i{0}; i < n_chunks;) {
+    size_t last = i + 1;
+    Chunk c = std::move(chunks[i]);
+
+    while (last < n_chunks && (c.failed || c.lexer->has_open_block())) {
+      last++;
+      c = lex_chunk(i, last);
+    }
+    if (c.failed) {
+      // the final chunk starts where the serial lexer would be, same error
+      c.lexer->throw_error();
+    }
+
+    if (last < n_chunks) {
+      c.lexer->tokens.pop_back(); // ENDOF of the chunk, not of the document
+    }
+    std::move(c.lexer->tokens.begin(), c.lexer->tokens.end(),
+              std::back_inserter(tokens));
+    owned_text.splice(owned_text.end(), c.lexer->owned_text);
+    open_verbatim = c.lexer->open_verbatim;
+    i = last;
+  }
+
+  pos = creole_data.size();
+  _V_ << " [BLexer] Parallel Block Tokenization Ended." << std::endl;
+}
+
+/*
+ * Lexes the next block and moves its token out, nothing is kept in tokens.
+ * Text views stay valid as long as the lexer, like with b_tokenize.
+ */
+bool BLexer::next_token(BToken &out) {
+  if (endof_pulled) {
+    return false;
+  }
+  if (end()) {
+    out = {BlockTokenType::ENDOF, base + pos};
+    endof_pulled = true;
+    return true;
+  }
+  if (!lex_block()) {
+    throw_error();
+  }
+  out = std::move(tokens.back());
+  tokens.pop_back();
+  return true;
 }
 
-std::vector<BToken> BLexer::get_tokens() {
+const std::vector<BToken> &BLexer::get_tokens() const {
   if (tokens.empty() || tokens.size() == 1) {
     throw B_LexerError(
         "Tried to call get_tokens function without populating the "
         "tokens or running lexer on an empty file",
         0);
-    return {};
   }
   return tokens;
 }
 
+std::shared_ptr<const CreoleSource> BLexer::get_source() const {
+  return source;
+}
+
+/*
+ * Line and column of a source offset, looked up in the source's line table
+ * (built on the first call).
+ */
+LinePos BLexer::position(size_t offset) const {
+  LinePos p = source->lines().position(offset);
+  p.line += first_line - 1;
+  return p;
+}
+
+/*=== Splitting ===*/
+
+/*
+ * A position right after a '\n' that starts an empty line or a heading/list
+ * marker. Every block ends before such a line (paragraphs stop at blank lines
+ * and markers, the rest are single lines), so lexing can restart there.
+ * Verbatim blocks and short "-" rules can still run across it, callers check
+ * has_open_block() or the lexer error for those.
+ */
+bool BLexer::is_block_boundary(std::string_view data, size_t at) {
+  if (at == 0 || at >= data.size() || data[at - 1] != '\n') {
+    return false;
+  }
+  char c = data[at];
+  return c == '\n' || c == '=' || c == '*' || c == '#';
+}
+
+/*
+ * Last block boundary in data, or npos if there is none.
+ */
+size_t BLexer::last_block_boundary(std::string_view data) {
+  size_t nl = data.size() < 2 ? std::string_view::npos
+                              : data.rfind('\n', data.size() - 2);
+  while (nl != std::string_view::npos) {
+    if (is_block_boundary(data, nl + 1)) {
+      return nl + 1;
+    }
+    if (nl == 0) {
+      break;
+    }
+    nl = data.rfind('\n', nl - 1);
+  }
+  return std::string_view::npos;
+}
+
+/*
+ * First block boundary at or after from, or npos if there is none.
+ */
+size_t BLexer::next_block_boundary(std::string_view data, size_t from) {
+  size_t at = std::max<size_t>(from, 1);
+  while (at < data.size()) {
+    if (is_block_boundary(data, at)) {
+      return at;
+    }
+    at = find_newline(data.data() + at, data.data() + data.size()) -
+         data.data() + 1;
+  }
+  return std::string_view::npos;
+}
+
+bool BLexer::has_open_block() const { return open_verbatim; }
+
+/*=== Incremental ===*/
+
+/* true if view is a slice of data and not of some owned string */
+static bool points_into(std::string_view view, std::string_view data) {
+  auto p = reinterpret_cast<uintptr_t>(view.data());
+  auto base = reinterpret_cast<uintptr_t>(data.data());
+  return p >= base && p <= base + data.size();
+}
+
+/*
+ * Moves a view into old_data onto the same bytes of new_data, shift bytes
+ * further on. Views into owned_text are left alone.
+ */
+static void rebase_view(std::optional<std::string_view> &view,
+                        std::string_view old_data, const char *new_data,
+                        ptrdiff_t shift) {
+  if (view.has_value() && points_into(*view, old_data)) {
+    view = std::string_view(new_data + (view->data() - old_data.data()) + shift,
+                            view->size());
+  }
+}
+
+static void rebase_inline(ITokenArena &i_tokens, std::string_view old_data,
+                          const char *new_data, ptrdiff_t shift) {
+  for (auto &it : i_tokens.all()) {
+    it.offset += shift;
+    rebase_view(it.content, old_data, new_data, shift);
+    rebase_view(it.url, old_data, new_data, shift);
+  }
+}
+
+/*
+ * Applies edit to the source and brings the tokens up to date without lexing
+ * the whole document again.
+ * A block can look one block ahead (a paragraph peeks at the next line to see
+ * where it ends), so lexing restarts at the block before the one holding the
+ * edit. From there blocks are lexed one at a time until the lexer lands on the
+ * start of an old block behind the edit: everything from that block on would
+ * lex exactly as before, so the old tokens are kept and only shifted.
+ * Lexing work is bounded by the edited blocks; the rest is a copy of the text
+ * and a pass moving token views onto it.
+ * If the new text fails to lex, the error is thrown and nothing is changed.
+ */
+TokenRange BLexer::relex(const TextEdit &edit) {
+  if (edit.offset > creole_data.size() ||
+      edit.removed > creole_data.size() - edit.offset) {
+    throw B_LexerError("Edit out of range of the source", 0);
+  }
+  std::string_view old_data = creole_data;
+  std::string text;
+  text.reserve(old_data.size() - edit.removed + edit.inserted.size());
+  text.append(old_data.substr(0, edit.offset));
+  text.append(edit.inserted);
+  text.append(old_data.substr(edit.offset + edit.removed));
+  auto new_source = CreoleSource::from_string(std::move(text));
+  std::string_view new_data = new_source->view();
+  _V_ << " [BLexer] Relexing edit at " << edit.offset << " (-"
+      << edit.removed << " +" << edit.inserted.size() << ")." << std::endl;
+
+  // nothing to reuse unless a full tokenize ran before
+  if (tokens.empty() || tokens.back().type != BlockTokenType::ENDOF) {
+    size_t old_count = tokens.size();
+    BLexer fresh(new_source, first_line);
+    fresh.b_tokenize();
+    if (inline_done) {
+      fresh.process_inline_tokens();
+    }
+    tokens = std::move(fresh.tokens);
+    owned_text = std::move(fresh.owned_text);
+    source = std::move(new_source);
+    creole_data = new_data;
+    pos = fresh.pos;
+    open_verbatim = fresh.open_verbatim;
+    return {0, tokens.size(), old_count};
+  }
+
+  ptrdiff_t shift = static_cast<ptrdiff_t>(edit.inserted.size()) -
+                    static_cast<ptrdiff_t>(edit.removed);
+
+  auto by_offset = [](size_t offset, const BToken &t) {
+    return offset < t.offset;
+  };
+  size_t last = tokens.size() - 1; // ENDOF
+  size_t holder = std::upper_bound(tokens.begin(), tokens.end(), edit.offset,
+                                   by_offset) -
+                  tokens.begin() - 1;
+  size_t first = holder > 0 ? holder - 1 : 0;
+
+  BLexer sub(new_source, first_line);
+  sub.pos = tokens[first].offset;
+  // first old block starting behind the edit, where lexing may converge
+  size_t reuse = std::lower_bound(tokens.begin() + first, tokens.begin() + last,
+                                  edit.offset + edit.removed,
+                                  [](const BToken &t, size_t offset) {
+                                    return t.offset < offset;
+                                  }) -
+                 tokens.begin();
+  bool converged{false};
+  while (!sub.end()) {
+    if (!sub.lex_block()) {
+      sub.throw_error();
+    }
+    while (reuse < last && tokens[reuse].offset + shift < sub.pos) {
+      reuse++;
+    }
+    if (reuse < last && tokens[reuse].offset + shift == sub.pos) {
+      converged = true;
+      break;
+    }
+  }
+  if (!converged) {
+    sub.tokens.push_back({BlockTokenType::ENDOF, sub.pos});
+    reuse = tokens.size();
+  }
+  if (inline_done) {
+    sub.process_inline_tokens();
+  }
+
+  // from here on nothing throws, swap in the new tokens
+  // owned texts of the dropped tokens go in one pass over owned_text
+  std::vector<const char *> dropped;
+  for (size_t k{first}; k < reuse; ++k) {
+    const auto &text = tokens[k].text;
+    if (text.has_value() && !points_into(*text, old_data)) {
+      dropped.push_back(text->data());
+    }
+  }
+  if (!dropped.empty()) {
+    std::sort(dropped.begin(), dropped.end());
+    owned_text.remove_if([&](const std::string &s) {
+      return std::binary_search(dropped.begin(), dropped.end(), s.data());
+    });
+  }
+  for (size_t k{0}; k < first; ++k) {
+    rebase_view(tokens[k].text, old_data, new_data.data(), 0);
+    rebase_inline(tokens[k].i_tokens, old_data, new_data.data(), 0);
+  }
+  for (size_t k{reuse}; k < tokens.size(); ++k) {
+    auto &t = tokens[k];
+    rebase_view(t.text, old_data, new_data.data(), shift);
+    rebase_inline(t.i_tokens, old_data, new_data.data(), shift);
+    t.offset += shift;
+  }
+
+  size_t count = sub.tokens.size();
+  if (count == reuse - first) {
+    std::move(sub.tokens.begin(), sub.tokens.end(), tokens.begin() + first);
+  } else {
+    tokens.erase(tokens.begin() + first, tokens.begin() + reuse);
+    tokens.insert(tokens.begin() + first,
+                  std::make_move_iterator(sub.tokens.begin()),
+                  std::make_move_iterator(sub.tokens.end()));
+  }
+  owned_text.splice(owned_text.end(), sub.owned_text);
+  if (!converged) {
+    open_verbatim = sub.open_verbatim;
+  }
+  source = std::move(new_source);
+  creole_data = new_data;
+  pos = creole_data.size();
+
+  _V_ << " [BLexer] Relexed " << count << " blocks in place of "
+      << reuse - first << "." << std::endl;
+  return {first, count, reuse - first};
+}
+
 /*=== Printing Functions ===*/
 std::string BLexer::token_to_string(BlockTokenType type) {
   switch (type) {
@@ -83,7 +428,8 @@ std::string BLexer::token_to_string(BlockTokenType type) {
 void BLexer::print_tokens() {
   for (const auto &t : tokens) {
     std::cout << "Type: " << token_to_string(t.type) << std::endl;
-    std::cout << "Loc: " << t.loc << std::endl;
+    LinePos p = position(t.offset);
+    std::cout << "Loc: " << p.line << ":" << p.column << std::endl;
     if (t.text.has_value()) {
       std::cout << "Text: " << t.text.value() << std::endl;
     }
@@ -99,169 +445,242 @@ void BLexer::print_tokens() {
 }
 
 /*=== Reading Functions ===*/
-void BLexer::read_heading() {
-  _V_ << " [BLexer] Reading and Processing Heading." << std::endl;
+
+/*
+ * Lexes the block at pos into exactly one token. The lexer only looks forward,
+ * so pos is all the state a block depends on, relex restarts here.
+ * Returns false with the error recorded (see fail) if the input ended inside
+ * the block.
+ */
+bool BLexer::lex_block() {
+  block_start = base + pos;
+  char c = peek();
+  if (is_whites()) {
+    while (is_whites()) {
+      advance();
+    }
+    tokens.push_back({BlockTokenType::NEWLINE, block_start});
+    if (is_newline()) {
+      advance();
+    }
+    return true;
+  }
+  switch (c) {
+  case '=':
+    return read_heading();
+  case '*':
+    return read_uli();
+  case '#':
+    return read_oli();
+  case '-':
+    return read_horizonalrule();
+  case '{':
+    if (at_verbatim_open()) {
+      return read_verbatim();
+    }
+    if (brace_cut_by_end()) {
+      return fail(LexErrorCode::UNEXPECTED_END);
+    }
+    return read_paragraph();
+  case '\n':
+    return read_blankline();
+  default:
+    return read_paragraph();
+  }
+}
+
+bool BLexer::read_heading() {
+  TRACE(BLOCK, "BLexer heading at", pos);
   int level{0};
   while (peek() == '=') {
     level++;
     advance();
   }
+  if (end()) {
+    return fail(LexErrorCode::UNEXPECTED_END);
+  }
 
-  std::string text;
-  while (!end() && !is_newline()) {
-    if (peek() == '=') {
-      advance();
-    } else {
-      text += peek();
-      advance();
+  size_t start = pos;
+  skip_line();
+  std::string_view line = creole_data.substr(start, pos - start);
+
+  // drop the optional closing '=' run, text stays a view into the source
+  std::string_view text = trim_view(line);
+  size_t last = text.find_last_not_of('=');
+  text = trim_view(text.substr(0, last + 1)); // npos + 1 wraps to 0
+
+  // '=' inside the heading text is dropped as well, needs an owned copy
+  if (text.find('=') != std::string_view::npos) {
+    std::string stripped;
+    for (char c : line) {
+      if (c != '=') {
+        stripped += c;
+      }
     }
+    owned_text.push_back(trim(stripped));
+    text = owned_text.back();
   }
-  tokens.push_back({BlockTokenType::HEADING, loc, trim(text), level});
-  advance(); // '\n'
+
+  tokens.push_back({BlockTokenType::HEADING, block_start, text, level});
+  return skip_newline();
 }
 
-void BLexer::read_uli() {
-  _V_ << " [BLexer] Reading and Processing Unordered List." << std::endl;
+bool BLexer::read_uli() {
+  TRACE(BLOCK, "BLexer unordered list at", pos);
   int level{0};
   while (peek() == '*') {
     level++;
     advance();
   }
-
-  std::string text;
-  while (!end() && !is_newline()) {
-    text += peek();
-    advance();
+  if (end()) {
+    return fail(LexErrorCode::UNEXPECTED_END);
   }
-  tokens.push_back({BlockTokenType::ULISTITEM, loc, trim(text), level});
-  advance(); // '\n'
+
+  size_t start = pos;
+  skip_line();
+  std::string_view text = creole_data.substr(start, pos - start);
+  tokens.push_back(
+      {BlockTokenType::ULISTITEM, block_start, trim_view(text), level});
+  return skip_newline();
 }
 
-void BLexer::read_oli() {
-  _V_ << " [BLexer] Reading and Processing Ordered List." << std::endl;
+bool BLexer::read_oli() {
+  TRACE(BLOCK, "BLexer ordered list at", pos);
   int level{0};
   while (peek() == '#') {
     level++;
     advance();
   }
-
-  std::string text;
-  while (!end() && !is_newline()) {
-    text += peek();
-    advance();
+  if (end()) {
+    return fail(LexErrorCode::UNEXPECTED_END);
   }
-  tokens.push_back({BlockTokenType::OLISTITEM, loc, trim(text), level});
-  advance(); // '\n'
+
+  size_t start = pos;
+  skip_line();
+  std::string_view text = creole_data.substr(start, pos - start);
+  tokens.push_back(
+      {BlockTokenType::OLISTITEM, block_start, trim_view(text), level});
+  return skip_newline();
 }
 
-void BLexer::read_horizonalrule() {
-  _V_ << " [BLexer] Reading and Processing Horizontal Rule." << std::endl;
-  for (int i{0}; i < 4; ++i) {
-    advance();
+bool BLexer::read_horizonalrule() {
+  TRACE(BLOCK, "BLexer horizontal rule at", pos);
+  size_t n = std::min<size_t>(4, creole_data.size() - pos);
+  advance(n);
+  if (n < 4) {
+    return fail(LexErrorCode::ADVANCE_PAST_END, 1);
   }
-  tokens.push_back({BlockTokenType::HORIZONTALRULE, loc});
-  advance(); // '\n'
+  tokens.push_back({BlockTokenType::HORIZONTALRULE, block_start});
+  return skip_newline();
 }
 
-void BLexer::read_paragraph() {
-  _V_ << " [BLexer] Reading and Processing Paragraph." << std::endl;
-  std::string text;
-  size_t start_loc = loc;
+bool BLexer::read_paragraph() {
+  TRACE(BLOCK, "BLexer paragraph at", pos);
+  size_t start = pos;
   while (!end()) {
     if (is_special()) {
       break;
     }
+    if (peek() == '{' && brace_cut_by_end()) {
+      return fail(LexErrorCode::UNEXPECTED_END);
+    }
 
-    while (!end() && !is_newline()) {
-      text += peek();
-      advance();
+    skip_line();
+    if (end()) {
+      return fail(LexErrorCode::UNEXPECTED_END); // no '\n' after the last line
     }
+    advance(); // '\n'
 
     if (is_newline()) {
-      advance();
-
-      if (!end() && is_newline()) {
-        break;
-      }
+      break;
+    }
 
-      size_t temp_pos = pos;
-      bool blank_line{true};
-      while (temp_pos < creole_data.size() && creole_data[temp_pos] != '\n') {
-        if (!std::isspace(creole_data[temp_pos])) {
-          blank_line = false;
-          break;
-        }
-        temp_pos++;
-      }
-      if (blank_line && temp_pos < creole_data.size() &&
-          creole_data[temp_pos] == '\n') {
-        break;
-      }
+    // a line of blanks ends the paragraph too, the sentinel stops the scan
+    const char *p = creole_data.data() + pos;
+    while (*p != '\n' && std::isspace(*p)) {
+      p++;
+    }
+    if (*p == '\n') {
+      break;
     }
-    text += '\n';
   }
 
-  tokens.push_back({BlockTokenType::PARAGRAPH, start_loc, trim(text)});
+  // the paragraph is the raw slice it consumed, newlines included
+  std::string_view text = creole_data.substr(start, pos - start);
+  tokens.push_back({BlockTokenType::PARAGRAPH, block_start, trim_view(text)});
+  return true;
 }
 
-void BLexer::read_verbatim() {
-  _V_ << " [BLexer] Reading and Processing Verbatim Block." << std::endl;
-  size_t _loc = loc;
+bool BLexer::read_verbatim() {
+  TRACE(BLOCK, "BLexer verbatim block at", pos);
   int depth{1};
   advance(3); // {
 
-  std::string text;
+  size_t start = pos;
+  size_t text_end = pos;
   while (!end() && depth > 0) {
-    if (peek() == '{' && lookahead() == '{' && lookahead(2) == '{') {
+    char c = peek();
+    if ((c == '{' || c == '}') && brace_cut_by_end()) {
+      return fail(LexErrorCode::UNEXPECTED_END);
+    }
+    if (at_verbatim_open()) {
       depth++;
-      text += "{{{";
       advance(3); // {
-    } else if (peek() == '}' && lookahead() == '}' && lookahead(2) == '}') {
+    } else if (at_verbatim_close()) {
       depth--;
       if (depth == 0) {
-        advance(3); // {
+        text_end = pos;
+        advance(3); // }
         break;
       } else {
-        text += "}}}";
-        advance(3); // {
+        advance(3); // }
       }
     } else {
-      text += peek();
-      advance();
+      // jump to the next brace
+      const char *next = find_first_of(creole_data.data() + pos,
+                                       creole_data.data() + creole_data.size(),
+                                       "{}");
+      advance(std::max<size_t>(1, next - (creole_data.data() + pos)));
     }
+    text_end = pos;
   }
-  tokens.push_back({BlockTokenType::VERBATIMBLOCK, _loc, text});
+  open_verbatim = depth > 0;
 
-  while (!end() && !is_newline()) {
-    advance();
-  }
+  // nested {{{ }}} stay part of the text, it is the raw slice
+  std::string_view text = creole_data.substr(start, text_end - start);
+  tokens.push_back({BlockTokenType::VERBATIMBLOCK, block_start, text});
+
+  skip_line();
   if (!end() && is_newline()) {
     advance(); // \n
   }
+  return true;
 }
 
-void BLexer::read_blankline() {
-  _V_ << " [BLexer] Reading and Processing Blankline." << std::endl;
-  while (!end() && !is_newline()) {
-    advance();
-  }
+bool BLexer::read_blankline() {
+  TRACE(BLOCK, "BLexer blankline at", pos);
   // let's just treat blankline as newline only
-  tokens.push_back({BlockTokenType::NEWLINE, loc});
+  tokens.push_back({BlockTokenType::NEWLINE, block_start});
   advance(); // '\n'
+  return true;
 }
 
-void BLexer::read_image() {
-  _V_ << " [BLexer] Reading and Processing Image Token." << std::endl;
+bool BLexer::read_image() {
+  TRACE(BLOCK, "BLexer image at", pos);
   advance(2); // {
 
-  std::string text;
+  size_t start = pos;
   while (!end() && !(peek() == '}' && lookahead() == '}')) {
-    text += peek();
     advance();
   }
+  std::string_view text = creole_data.substr(start, pos - start);
+  if (creole_data.size() - pos < 2) {
+    return fail(LexErrorCode::ADVANCE_PAST_END, 2);
+  }
   advance(2); // }
 
-  tokens.push_back({BlockTokenType::IMAGE, loc, trim(text)});
+  tokens.push_back({BlockTokenType::IMAGE, block_start, trim_view(text)});
+  return true;
 }
 
 /*=== Inline ===*/
@@ -271,52 +690,100 @@ void BLexer::process_inline_tokens() {
 
   for (auto &t : tokens) {
     if (t.text.has_value() && t.type != BlockTokenType::VERBATIMBLOCK) {
-      t.i_tokens = i_lexer.tokenize(t.text.value(), t.loc);
-      _V_ << " [BLexer] Processed inline tokens for: "
-          << t.text.value_or("[EMPTY]") << std::endl;
+      // owned heading text has no offset of its own, use the block's
+      size_t text_offset = source->offset_of(t.text.value());
+      t.i_tokens = i_lexer.tokenize(
+          t.text.value(),
+          text_offset == std::string_view::npos ? t.offset : text_offset);
+      TRACE(BLOCK, "BLexer inline tokens of block at", t.offset);
     }
   }
+  inline_done = true;
 }
 
 /*=== Helper Functions ===*/
-inline bool BLexer::end() { return pos >= creole_data.size(); }
 
-void BLexer::advance(size_t offset) {
-  if (!end() && pos + offset <= creole_data.size()) {
-    for (size_t i{0}; i < offset; i++) {
-      if (creole_data[pos + i] == '\n') {
-        loc++;
-      }
-    }
-    pos += offset;
-  } else {
+/* line of pos, the table is only built when an error needs it */
+size_t BLexer::current_line() { return position(base + pos).line; }
+
+/*
+ * Records an error at pos and returns false, the read functions bail out with
+ * `return fail(...)` and b_tokenize turns the record into a B_LexerError.
+ */
+bool BLexer::fail(LexErrorCode code, size_t steps) {
+  error = code;
+  error_pos = pos;
+  error_steps = steps;
+  return false;
+}
+
+void BLexer::throw_error() const {
+  size_t line = position(base + error_pos).line;
+  if (error == LexErrorCode::ADVANCE_PAST_END) {
     throw B_LexerError("Unexpected end of tokens while advancing" +
-                           std::to_string(offset) + " steps",
-                       loc);
+                           std::to_string(error_steps) + " steps",
+                       line);
   }
+  throw B_LexerError("Unexpected end of tokens", line);
 }
 
-char BLexer::peek() {
-  if (!end()) {
-    return creole_data[pos];
-  }
-  throw B_LexerError("Unexpected end of tokens", loc);
+inline bool BLexer::end() const { return pos >= creole_data.size(); }
+
+/* callers know the bytes are there */
+inline void BLexer::advance(size_t offset) { pos += offset; }
+
+/*
+ * Moves pos to the next '\n' (or the end) in one scan.
+ */
+void BLexer::skip_line() {
+  const char *p = creole_data.data() + pos;
+  pos += find_newline(p, creole_data.data() + creole_data.size()) - p;
 }
 
-char BLexer::lookahead(size_t offset) {
-  if (!end() && pos + offset < creole_data.size()) {
-    return creole_data[pos + offset];
+/* steps over the '\n' ending a single line block */
+inline bool BLexer::skip_newline() {
+  if (end()) {
+    return fail(LexErrorCode::ADVANCE_PAST_END, 1);
   }
-  throw B_LexerError("Unexpected end of tokens", loc);
+  advance();
+  return true;
+}
+
+/*
+ * No bounds checks: the source is NUL padded and a slice given to a chunk
+ * lexer always ends with '\n', so every scan stops before running off.
+ */
+inline char BLexer::peek() const { return creole_data.data()[pos]; }
+
+inline char BLexer::lookahead(size_t offset) const {
+  return creole_data.data()[pos + offset];
+}
+
+inline bool BLexer::at_verbatim_open() const {
+  return std::memcmp(creole_data.data() + pos, "{{{", 3) == 0;
+}
+
+inline bool BLexer::at_verbatim_close() const {
+  return std::memcmp(creole_data.data() + pos, "}}}", 3) == 0;
+}
+
+/*
+ * A '{' or '}' run the input ends in before it is three long. The lexer always
+ * treated this as running into the end, the sentinel alone would not tell.
+ */
+inline bool BLexer::brace_cut_by_end() const {
+  return pos + 1 >= creole_data.size() ||
+         (lookahead() == peek() && pos + 2 >= creole_data.size());
 }
 
-inline bool BLexer::is_newline() { return peek() == '\n'; }
+inline bool BLexer::is_newline() const { return peek() == '\n'; }
 
-inline bool BLexer::is_whites() {
+inline bool BLexer::is_whites() const {
   return (peek() != '\n' && std::isspace(peek()));
 }
 
-inline bool BLexer::is_special() {
-  return (peek() == '=' || peek() == '*' || peek() == '#' || peek() == '-' ||
-          (peek() == '{' && lookahead() == '{' && lookahead(2) == '{'));
+inline bool BLexer::is_special() const {
+  char c = peek();
+  return c == '=' || c == '*' || c == '#' || c == '-' ||
+         (c == '{' && at_verbatim_open());
 }
@@ -0,0 +1,126 @@
+#include "b_stream_lexer.h"
+#include "globals.h"
+#include "scan.h"
+#include <algorithm>
+#include <cerrno>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+BStreamLexer::BStreamLexer(std::istream &in, size_t chunk_size)
+    : in(&in), fd(-1), chunk_size(std::max<size_t>(chunk_size, 1)),
+      want(this->chunk_size), loc(1), offset(0), batch_offset(0),
+      batch_pos(0), eof(false), done(false) {}
+
+BStreamLexer::BStreamLexer(int fd, size_t chunk_size)
+    : in(nullptr), fd(fd), chunk_size(std::max<size_t>(chunk_size, 1)),
+      want(this->chunk_size), loc(1), offset(0), batch_offset(0),
+      batch_pos(0), eof(false), done(false) {}
+
+/*
+ * Hands out the next block token, lexing a new batch when the current one is
+ * used up. Returns false after the final ENDOF token.
+ */
+bool BStreamLexer::next_token(BToken &out) {
+  while (batch_pos >= batch.size()) {
+    if (!lex_next_batch()) {
+      return false;
+    }
+  }
+  out = std::move(batch[batch_pos++]);
+  return true;
+}
+
+size_t BStreamLexer::buffered_bytes() const { return window.size(); }
+
+LinePos BStreamLexer::position(size_t offset) const {
+  if (!batch_lexer) {
+    return {loc, 1};
+  }
+  return batch_lexer->position(offset - batch_offset);
+}
+
+/*
+ * Appends up to chunk_size bytes from the input to the window.
+ */
+bool BStreamLexer::read_chunk() {
+  size_t old_size = window.size();
+  window.resize(old_size + chunk_size);
+  size_t n{0};
+
+  if (in) {
+    in->read(window.data() + old_size, chunk_size);
+    n = static_cast<size_t>(in->gcount());
+  } else {
+#if defined(__unix__) || defined(__APPLE__)
+    ssize_t r;
+    do {
+      r = read(fd, window.data() + old_size, chunk_size);
+    } while (r < 0 && errno == EINTR);
+    n = r > 0 ? static_cast<size_t>(r) : 0;
+#endif
+  }
+
+  window.resize(old_size + n);
+  return n > 0;
+}
+
+/*
+ * Lexes the window up to its last block boundary. A batch only counts if it
+ * ended cleanly; if a verbatim block (or a lexer error near the cut) shows the
+ * cut was inside a block, more input is read and the batch is retried with a
+ * later boundary. The window grows geometrically while that happens so huge
+ * blocks are not re-lexed over and over.
+ */
+bool BStreamLexer::lex_next_batch() {
+  if (done) {
+    return false;
+  }
+
+  while (true) {
+    while (!eof && window.size() < want) {
+      eof = !read_chunk();
+    }
+
+    size_t cut = eof ? window.size() : BLexer::last_block_boundary(window);
+    if (cut != std::string::npos) {
+      auto lexer = std::make_unique<BLexer>(
+          CreoleSource::from_string(window.substr(0, cut)), loc);
+
+      bool clean = lexer->try_tokenize();
+      if (eof) {
+        if (!clean) {
+          lexer->throw_error(); // errors of the final batch are real errors
+        }
+      } else {
+        clean = clean && !lexer->has_open_block();
+      }
+
+      if (clean) {
+        batch = std::move(lexer->tokens);
+        if (!eof) {
+          batch.pop_back(); // ENDOF of this batch, not of the document
+        }
+        for (auto &t : batch) {
+          t.offset += offset;
+        }
+        batch_pos = 0;
+        batch_lexer = std::move(lexer);
+
+        loc += count_newlines(window.data(), window.data() + cut);
+        batch_offset = offset;
+        offset += cut;
+        window.erase(0, cut);
+        want = chunk_size;
+        done = eof;
+        _V_ << " [BStreamLexer] Lexed batch of " << cut << " bytes, "
+            << batch.size() << " tokens." << std::endl;
+        return true;
+      }
+    }
+
+    // no complete block buffered yet, at least double what we hold
+    want = window.size() + std::max(chunk_size, window.size());
+  }
+}
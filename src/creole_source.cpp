@@ -0,0 +1,165 @@
+#include "creole_source.h"
+#include "globals.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CN_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Opens the creole file at filepath.
+ * Regular files are mapped read-only, everything else (pipes, fifos, "-" for
+ * stdin) is read once into an owned buffer.
+ */
+std::shared_ptr<const CreoleSource>
+CreoleSource::open(const std::string &filepath) {
+  std::shared_ptr<CreoleSource> src(new CreoleSource());
+
+#ifdef CN_HAVE_MMAP
+  int fd = filepath == "-" ? STDIN_FILENO : ::open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "File not found: " << filepath << std::endl;
+    exit(1);
+  }
+
+  struct stat st;
+  bool mapped = false;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    mapped = src->map_file(fd, static_cast<size_t>(st.st_size));
+  }
+  if (!mapped) {
+    src->read_fd(fd);
+  }
+
+  if (fd != STDIN_FILENO) {
+    close(fd);
+  }
+#else
+  if (filepath == "-") {
+    src->owned_.assign(std::istreambuf_iterator<char>(std::cin),
+                       std::istreambuf_iterator<char>());
+  } else {
+    std::ifstream infile(filepath, std::ios::binary);
+    if (!infile) {
+      std::cerr << "File not found: " << filepath << std::endl;
+      exit(1);
+    }
+    src->owned_.assign(std::istreambuf_iterator<char>(infile),
+                       std::istreambuf_iterator<char>());
+  }
+  src->size_ = src->owned_.size();
+  src->owned_.append(padding, '\0');
+  src->data_ = src->owned_.data();
+#endif
+
+  _V_ << " [CreoleSource] Loaded " << src->size_ << " bytes ("
+      << (src->is_mapped() ? "mapped" : "buffered") << ")." << std::endl;
+  return src;
+}
+
+/*
+ * Wraps an in-memory string, used for tests and already loaded documents.
+ */
+std::shared_ptr<const CreoleSource>
+CreoleSource::from_string(std::string data) {
+  std::shared_ptr<CreoleSource> src(new CreoleSource());
+  src->owned_ = std::move(data);
+  src->size_ = src->owned_.size();
+  src->owned_.append(padding, '\0');
+  src->data_ = src->owned_.data();
+  return src;
+}
+
+const LineTable &CreoleSource::lines() const {
+  std::call_once(lines_once_, [this] { lines_ = LineTable(view()); });
+  return lines_;
+}
+
+size_t CreoleSource::offset_of(std::string_view text) const {
+  auto p = reinterpret_cast<uintptr_t>(text.data());
+  auto base = reinterpret_cast<uintptr_t>(data_);
+  if (p < base || p > base + size_) {
+    return std::string_view::npos;
+  }
+  return p - base;
+}
+
+CreoleSource::~CreoleSource() {
+#ifdef CN_HAVE_MMAP
+  if (mapped_) {
+    munmap(mapped_, mapped_size_);
+  }
+#endif
+}
+
+/*
+ * Maps size bytes of fd read-only. Returns false if the kernel refuses, in
+ * which case the caller falls back to reading.
+ * The file is mapped over an anonymous reservation one padding longer, the
+ * kernel zero-fills the rest of the file's last page and the reserved pages
+ * behind it read as zeros too.
+ */
+bool CreoleSource::map_file(int fd, size_t size) {
+#ifdef CN_HAVE_MMAP
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t total = (size + padding + page - 1) / page * page;
+  void *addr = mmap(nullptr, total, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1, 0);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  if (mmap(addr, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+      MAP_FAILED) {
+    munmap(addr, total);
+    return false;
+  }
+  madvise(addr, size, MADV_SEQUENTIAL);
+  mapped_ = addr;
+  mapped_size_ = total;
+  data_ = static_cast<const char *>(addr);
+  size_ = size;
+  return true;
+#else
+  (void)fd;
+  (void)size;
+  return false;
+#endif
+}
+
+/*
+ * Reads everything from fd into the owned buffer, growing it geometrically so
+ * pipes of unknown length are read without per-character work.
+ */
+void CreoleSource::read_fd(int fd) {
+#ifdef CN_HAVE_MMAP
+  size_t len = 0;
+  owned_.resize(1 << 16);
+  while (true) {
+    if (len == owned_.size()) {
+      owned_.resize(owned_.size() * 2);
+    }
+    ssize_t n = read(fd, owned_.data() + len, owned_.size() - len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    len += static_cast<size_t>(n);
+  }
+  owned_.resize(len);
+#else
+  (void)fd;
+#endif
+  size_ = owned_.size();
+  owned_.append(padding, '\0');
+  data_ = owned_.data();
+}
@@ -0,0 +1,63 @@
+#include "hash.h"
+#include <bit>
+#include <cstring>
+
+static constexpr uint64_t P1 = 0x9e3779b185ebca87ULL;
+static constexpr uint64_t P2 = 0xc2b2ae3d27d4eb4fULL;
+static constexpr uint64_t P3 = 0x165667b19e3779f9ULL;
+static constexpr uint64_t P4 = 0x85ebca77c2b2ae63ULL;
+static constexpr uint64_t P5 = 0x27d4eb2f165667c5ULL;
+
+/* little endian load, so big endian hosts hash the same */
+static inline uint64_t read64(const char *p) {
+  unsigned char b[8];
+  std::memcpy(b, p, 8);
+  if constexpr (std::endian::native == std::endian::little) {
+    uint64_t v;
+    std::memcpy(&v, b, 8);
+    return v;
+  }
+  uint64_t v{0};
+  for (int i{7}; i >= 0; --i) {
+    v = (v << 8) | b[i];
+  }
+  return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t v) {
+  acc += v * P2;
+  return std::rotl(acc, 31) * P1;
+}
+
+static inline uint64_t avalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  h ^= h >> 32;
+  return h;
+}
+
+/*
+ * One accumulator instead of xxHash64's four: node content is mostly short,
+ * where the single lane is faster, and the result only has to be stable.
+ */
+uint64_t hash64(std::string_view data, uint64_t seed) {
+  const char *p = data.data();
+  const char *end = p + data.size();
+  uint64_t h = seed + P5 + data.size();
+
+  for (; end - p >= 8; p += 8) {
+    h ^= round64(0, read64(p));
+    h = std::rotl(h, 27) * P1 + P4;
+  }
+  for (; p < end; ++p) {
+    h ^= static_cast<unsigned char>(*p) * P5;
+    h = std::rotl(h, 11) * P1;
+  }
+  return avalanche(h);
+}
+
+uint64_t hash_combine(uint64_t h, uint64_t v) {
+  return avalanche(round64(h, v) + P4);
+}
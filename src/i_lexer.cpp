@@ -1,66 +1,58 @@
 #include "i_lexer.h"
 #include "globals.h"
+#include "scan.h"
+#include "url_scheme.h"
 #include "utils.h"
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 
-std::vector<IToken> ILexer::tokenize(const std::string &input, size_t s_loc) {
+/* the copy is one exactly sized array, the arena keeps its memory */
+ITokenArena ILexer::tokenize(std::string_view input, size_t s_offset) {
+  return tokenize_in_place(input, s_offset);
+}
+
+const ITokenArena &ILexer::tokenize_in_place(std::string_view input,
+                                             size_t s_offset) {
   /* heating the engine vroom...vrooooom */
-  heat_the_engine(input, s_loc);
+  heat_the_engine(input, s_offset);
 
-  _V_ << " [ILexer] Starting Inline Tokenization..." << std::endl;
+  TRACE(INLINE, "ILexer tokenize at", s_offset);
   while (!end()) {
-    char c = inline_data[pos];
-
-    switch (curr_state) {
-    case State::NORMAL:
-      handle_normal_state(c);
-      break;
-    case State::IN_BOLD:
-      handle_bold_state(c);
-      break;
-    case State::IN_ITALIC:
-      handle_italic_state(c);
-      break;
-    case State::IN_LINK:
-      handle_link_state(c);
-      break;
-    case State::IN_IMAGE:
-      handle_image_state(c);
-      break;
-    case State::IN_VERBATIM:
-      handle_verbatim_state(c);
-      break;
-    case State::IN_ESCAPE:
-      handle_escape_state(c);
-      break;
-    default:
-      std::cerr << "Unknown State" << std::endl;
-      exit(1);
+    if (takes_plain_run()) {
+      // the bytes up to the next marker are plain text in every state that
+      // takes a run, add them in one step
+      const char *from = inline_data.data() + pos;
+      size_t run = find_first_of(from, inline_data.data() + inline_data.size(),
+                                 markers) -
+                   from;
+      if (run) {
+        take_plain_run(run);
+        continue;
+      }
     }
+    step(inline_data[pos]);
     advance();
-
-    if (c == '\n') {
-    }
   }
 
   finalize_current_text();
+  arena.root_range = store_siblings();
 
-  _V_ << " [ILexer] Inline Tokenization Ended." << std::endl;
-  return i_tokens;
+  TRACE(INLINE, "ILexer tokens", arena.tokens.size());
+  return arena;
 }
 
 /*=== Formatting Location ===*/
 void ILexer::start_formatting() {
   fmt_pos = pos;
-  fmt_loc = loc;
-  fmt_stack.push_back(loc);
+  fmt_stack.push_back(pos);
 }
 
-size_t ILexer::get_format_start_loc() {
+size_t ILexer::get_format_start_offset() {
   if (fmt_stack.empty()) {
-    return loc;
+    return base_offset + pos;
   }
-  return fmt_stack.back();
+  return base_offset + fmt_stack.back();
 }
 
 void ILexer::end_formatting() {
@@ -95,10 +87,11 @@ std::string ILexer::token_type_to_string(InlineTokenType type) {
   }
 }
 
-void ILexer::print_inline_tokens(const std::vector<IToken> &tokens) {
+static void print_inline_range(const ITokenArena &arena,
+                               std::span<const IToken> tokens) {
   for (const auto &t : tokens) {
-    std::cout << "Type: " << token_type_to_string(t.type) << std::endl;
-    std::cout << "Loc: " << t.loc << std::endl;
+    std::cout << "Type: " << ILexer::token_type_to_string(t.type) << std::endl;
+    std::cout << "Offset: " << t.offset << std::endl;
 
     if (t.content.has_value()) {
       std::cout << "Content: " << t.content.value() << std::endl;
@@ -108,23 +101,146 @@ void ILexer::print_inline_tokens(const std::vector<IToken> &tokens) {
       std::cout << "URL: " << t.url.value() << std::endl;
     }
 
-    if (!t.children.empty()) {
+    if (t.children.count) {
       std::cout << "Children: " << std::endl;
-      print_inline_tokens(t.children);
+      print_inline_range(arena, arena.children(t));
     }
   }
 }
 
+void ILexer::print_inline_tokens(const ITokenArena &tokens) {
+  print_inline_range(tokens, tokens.roots());
+}
+
 /*=== Handling Children ===*/
-std::vector<IToken> ILexer::recursive_tokenize(const std::string &input,
-                                               size_t s_loc) {
-  ILexer nested_lexer;
-  return nested_lexer.tokenize(input, s_loc);
+/*
+ * Hands the byte at pos, just added to curr_text, to the nested lexer. The
+ * first byte of a span starts it over on this lexer's input; bytes it skipped
+ * with a multi-byte advance are not handed again.
+ */
+void ILexer::feed_nested(char c) {
+  if (curr_text.size() == 1) {
+    start_nested();
+  }
+  if (nested->pos == pos) {
+    nested->step(c);
+    nested->advance();
+  }
+}
+
+void ILexer::start_nested() {
+  if (!nested) {
+    nested = std::make_unique<ILexer>();
+  }
+  nested->heat_the_engine(inline_data, base_offset);
+  nested->pos = pos;
+  nested->outer = this;
+  nested->out = out;
+}
+
+/*
+ * True if a run of bytes without markers is plain text to this lexer and to
+ * the nested lexers it feeds: NORMAL adds it to the text, bold and italic
+ * collect it and hand it on.
+ */
+bool ILexer::takes_plain_run() const {
+  switch (curr_state) {
+  case State::NORMAL:
+    return true;
+  case State::IN_BOLD:
+  case State::IN_ITALIC:
+    return curr_text.empty() ||
+           (nested->pos == pos && nested->takes_plain_run());
+  default:
+    return false;
+  }
+}
+
+/* what n single steps over plain bytes would do, in one */
+void ILexer::take_plain_run(size_t n) {
+  bool span_start = curr_text.empty();
+  extend_current_text(n);
+  if (curr_state != State::NORMAL) {
+    if (span_start) {
+      start_nested();
+    }
+    nested->take_plain_run(n);
+  }
+  pos += n;
+}
+
+/* the span closed at pos, the nested lexer has seen all of it */
+ITokenRange ILexer::close_nested() {
+  nested->finalize_current_text();
+  return nested->store_siblings();
+}
+
+ITokenRange ILexer::store_siblings() {
+  ITokenRange run{static_cast<uint32_t>(out->tokens.size()),
+                  static_cast<uint32_t>(i_tokens.size())};
+  out->tokens.insert(out->tokens.end(), i_tokens.begin(), i_tokens.end());
+  i_tokens.clear();
+  return run;
+}
+
+bool ILexer::span_ends_at(size_t q) const {
+  return q >= inline_data.size() || (outer && outer->closes_at(q));
+}
+
+bool ILexer::closes_at(size_t q) const {
+  if (span_ends_at(q)) {
+    return true;
+  }
+  char mark = curr_state == State::IN_BOLD ? '*' : '/';
+  if (inline_data[q] != mark) {
+    return false;
+  }
+  // the second mark may be cut off by our own end, then it reads the first
+  return span_ends_at(q + 1) || inline_data[q + 1] == mark;
+}
+
+/* first q in (p, p + k] where our span ends, p + k + 1 if it goes on */
+size_t ILexer::span_end_within(size_t p, size_t k) const {
+  for (size_t q = p + 1; q <= p + k; ++q) {
+    if (span_ends_at(q)) {
+      return q;
+    }
+  }
+  return p + k + 1;
 }
 
 /*=== Processing Functions ===*/
+inline void ILexer::step(char c) {
+  switch (curr_state) {
+  case State::NORMAL:
+    handle_normal_state(c);
+    break;
+  case State::IN_BOLD:
+    handle_bold_state(c);
+    break;
+  case State::IN_ITALIC:
+    handle_italic_state(c);
+    break;
+  case State::IN_LINK:
+    handle_link_state(c);
+    break;
+  case State::IN_IMAGE:
+    handle_image_state(c);
+    break;
+  case State::IN_VERBATIM:
+    handle_verbatim_state(c);
+    break;
+  case State::IN_ESCAPE:
+    handle_escape_state(c);
+    break;
+  default:
+    std::cerr << "Unknown State" << std::endl;
+    exit(1);
+  }
+}
+
 void ILexer::handle_normal_state(char c) {
-  _V_ << " [ILexer] Current State: NORMAL." << std::endl;
+  TRACE(INLINE, "ILexer NORMAL at", pos);
   switch (c) {
   case '*':
     if (lookahead() == '*') {
@@ -133,29 +249,17 @@ void ILexer::handle_normal_state(char c) {
       curr_state = State::IN_BOLD;
       advance();
     } else {
-      curr_text += c;
+      extend_current_text();
     }
     break;
 
   case '/':
     if (lookahead() == '/') {
-      // immediately after "http:" or "ftp:"
-      bool after_url_protocol = false;
-      if (curr_text.size() >= 5) {
-        std::string last5 = curr_text.substr(curr_text.size() - 5);
-        if (last5 == "http:" || last5 == "HTTP:") {
-          after_url_protocol = true;
-        }
-      }
-      if (!after_url_protocol && curr_text.size() >= 4) {
-        std::string last4 = curr_text.substr(curr_text.size() - 4);
-        if (last4 == "ftp:" || last4 == "FTP:") {
-          after_url_protocol = true;
-        }
-      }
+      // "http://" is not italic, even when it did not make a url
+      bool after_url_protocol = after_url_scheme();
 
       if (after_url_protocol) {
-        curr_text += c;
+        extend_current_text();
       } else {
         // start italic formatting.
         finalize_current_text();
@@ -164,7 +268,7 @@ void ILexer::handle_normal_state(char c) {
         advance();
       }
     } else {
-      curr_text += c;
+      extend_current_text();
     }
     break;
 
@@ -175,7 +279,7 @@ void ILexer::handle_normal_state(char c) {
       curr_state = State::IN_LINK;
       advance();
     } else {
-      curr_text += c;
+      extend_current_text();
     }
     break;
 
@@ -192,7 +296,13 @@ void ILexer::handle_normal_state(char c) {
       curr_state = State::IN_VERBATIM;
       advance(2);
     } else {
-      curr_text += c;
+      extend_current_text();
+    }
+    break;
+
+  case ':':
+    if (!take_bare_url()) {
+      extend_current_text();
     }
     break;
 
@@ -205,31 +315,30 @@ void ILexer::handle_normal_state(char c) {
   case '\\':
     if (lookahead() == '\\') {
       finalize_current_text();
-      add_token(InlineTokenType::LINEBREAK);
+      add_token(InlineTokenType::LINEBREAK, base_offset + pos);
       advance();
     } else {
-      curr_text += c;
+      extend_current_text();
     }
     break;
 
   default:
-    curr_text += c;
+    extend_current_text();
     break;
   }
 }
 
 void ILexer::handle_bold_state(char c) {
-  _V_ << " [ILexer] Current State: IN_BOLD." << std::endl;
+  TRACE(INLINE, "ILexer IN_BOLD at", pos);
   if (c == '*' && lookahead() == '*') {
     if (!curr_text.empty()) {
-      // recursively tokenizing the content for nested formatting
-      auto nested_tokens = recursive_tokenize(curr_text, fmt_loc);
+      ITokenRange children = close_nested();
 
-      IToken bold_token(InlineTokenType::BOLD, loc);
-      bold_token.children = nested_tokens;
+      IToken bold_token(InlineTokenType::BOLD, get_format_start_offset());
+      bold_token.children = children;
       i_tokens.push_back(bold_token);
 
-      curr_text.clear();
+      curr_text = {};
     }
     end_formatting();
     curr_state = State::NORMAL;
@@ -238,21 +347,22 @@ void ILexer::handle_bold_state(char c) {
     finalize_current_text();
     curr_state = State::IN_ESCAPE;
   } else {
-    curr_text += c;
+    extend_current_text();
+    feed_nested(c);
   }
 }
 
 void ILexer::handle_italic_state(char c) {
-  _V_ << " [ILexer] Current State: IN_ITALIC." << std::endl;
+  TRACE(INLINE, "ILexer IN_ITALIC at", pos);
   if (c == '/' && lookahead() == '/') {
     if (!curr_text.empty()) {
-      auto nested_tokens = recursive_tokenize(curr_text, fmt_loc);
+      ITokenRange children = close_nested();
 
-      IToken italic_token(InlineTokenType::ITALIC, loc);
-      italic_token.children = nested_tokens;
+      IToken italic_token(InlineTokenType::ITALIC, get_format_start_offset());
+      italic_token.children = children;
       i_tokens.push_back(italic_token);
 
-      curr_text.clear();
+      curr_text = {};
     }
     end_formatting();
     curr_state = State::NORMAL;
@@ -261,32 +371,35 @@ void ILexer::handle_italic_state(char c) {
     finalize_current_text();
     curr_state = State::IN_ESCAPE;
   } else {
-    curr_text += c;
+    extend_current_text();
+    feed_nested(c);
   }
 }
 
 void ILexer::handle_link_state(char c) {
-  _V_ << " [ILexer] Current State: IN_LINK." << std::endl;
+  TRACE(INLINE, "ILexer IN_LINK at", pos);
   if (c == ']' && lookahead() == ']') {
     // parsing link content here
-    std::string content = curr_text;
-    curr_text.clear();
+    std::string_view content = curr_text;
+    curr_text = {};
 
     // format -> [[url|text]] or [[url]]
-    std::string url;
-    std::string text;
+    std::string_view url;
+    std::string_view text;
 
     size_t pipe = content.find('|');
-    if (pipe != std::string::npos) {
-      url = trim(content.substr(0, pipe));
-      text = trim(content.substr(pipe + 1));
+    if (pipe != std::string_view::npos) {
+      url = trim_view(content.substr(0, pipe));
+      text = trim_view(content.substr(pipe + 1));
 
-      IToken link_token(InlineTokenType::LINK, loc, text, url);
+      IToken link_token(InlineTokenType::LINK, get_format_start_offset(), text,
+                        url);
       i_tokens.push_back(link_token);
     } else {
-      url = trim(content);
+      url = trim_view(content);
 
-      IToken link_token(InlineTokenType::LINK, loc, url, url);
+      IToken link_token(InlineTokenType::LINK, get_format_start_offset(), url,
+                        url);
       i_tokens.push_back(link_token);
     }
 
@@ -294,107 +407,215 @@ void ILexer::handle_link_state(char c) {
     curr_state = State::NORMAL;
     advance();
   } else {
-    curr_text += c;
+    extend_current_text();
   }
 }
 
 void ILexer::handle_image_state(char c) {
-  _V_ << " [ILexer] Current State: IN_IMAGE." << std::endl;
+  TRACE(INLINE, "ILexer IN_IMAGE at", pos);
   if (c == '}' && lookahead() == '}') {
     // parse image content
-    std::string content = curr_text;
-    curr_text.clear();
+    std::string_view content = curr_text;
+    curr_text = {};
 
     // format -> {{url|alt}} or {{url}}
-    std::string url;
-    std::string alt;
+    std::string_view url;
+    std::string_view alt;
 
     size_t pipe = content.find('|');
-    if (pipe != std::string::npos) {
-      url = trim(content.substr(0, pipe));
-      alt = trim(content.substr(pipe + 1));
+    if (pipe != std::string_view::npos) {
+      url = trim_view(content.substr(0, pipe));
+      alt = trim_view(content.substr(pipe + 1));
     } else {
-      url = trim(content);
+      url = trim_view(content);
       alt = "";
     }
 
-    IToken img_token(InlineTokenType::IMAGE, loc, alt, url);
+    IToken img_token(InlineTokenType::IMAGE, get_format_start_offset(), alt,
+                     url);
     i_tokens.push_back(img_token);
 
     end_formatting();
     curr_state = State::NORMAL;
     advance();
   } else {
-    curr_text += c;
+    extend_current_text();
   }
 }
 
 void ILexer::handle_verbatim_state(char c) {
-  _V_ << " [ILexer] Current State: IN_VERBATIM." << std::endl;
+  TRACE(INLINE, "ILexer IN_VERBATIM at", pos);
   if (c == '}' && lookahead() == '}' && lookahead(2) == '}') {
-    add_token(InlineTokenType::VERBATIM, curr_text);
-    curr_text.clear();
+    add_token(InlineTokenType::VERBATIM, get_format_start_offset(), curr_text);
+    curr_text = {};
     end_formatting();
     curr_state = State::NORMAL;
     advance(2);
   } else {
-    curr_text += c;
+    extend_current_text();
   }
 }
 
 void ILexer::handle_escape_state(char c) {
-  _V_ << " [ILexer] Current State: IN_ESCAPE." << std::endl;
-  curr_text += c;
+  TRACE(INLINE, "ILexer IN_ESCAPE at", pos);
+  extend_current_text();
+  escaped_at = pos;
   curr_state = State::NORMAL;
 }
 
+/*
+ * Links the bare url whose scheme ends at the ':' at pos, or returns false if
+ * there is none. A scheme glued to a word ("xhttp:") or starting with an
+ * escaped char ("~http:") is text, and so is a scheme with nothing after it.
+ */
+bool ILexer::take_bare_url() {
+  const UrlScheme *scheme = scheme_at_end(curr_text);
+  if (!scheme) {
+    return false;
+  }
+  size_t start = pos - scheme->name.size();
+  if (start == escaped_at ||
+      (start > 0 &&
+       std::isalnum(static_cast<unsigned char>(inline_data[start - 1])))) {
+    return false;
+  }
+
+  size_t body = pos + 1;
+  if (scheme->slashes) {
+    for (; body < pos + 3; ++body) {
+      if (span_ends_at(body) || inline_data[body] != '/') {
+        return false;
+      }
+    }
+  }
+  size_t url_end = bare_url_end(body);
+  if (url_end == body) {
+    return false;
+  }
+
+  curr_text.remove_suffix(scheme->name.size());
+  finalize_current_text();
+  std::string_view url = inline_data.substr(start, url_end - start);
+  add_token(InlineTokenType::LINK, base_offset + start, url, url);
+  advance(url_end - 1 - pos); // the loop steps onto url_end
+  return true;
+}
+
+/*=== URL Detection ===*/
+bool ILexer::after_url_scheme() const {
+  if (curr_text.size() < 2 || curr_text.back() != ':') {
+    return false;
+  }
+  const UrlScheme *scheme =
+      scheme_at_end(curr_text.substr(0, curr_text.size() - 1));
+  return scheme && scheme->slashes;
+}
+
+/*
+ * A url runs up to whitespace, a char that can't be in one unescaped, or
+ * markup that would close around it. Punctuation at its end belongs to the
+ * sentence, a ')' only when it has no '(' to close.
+ */
+size_t ILexer::bare_url_end(size_t q) const {
+  static constexpr std::string_view stops = " \t\r\n\f\v[]{}|<>\"";
+  size_t from = q;
+  for (; !span_ends_at(q); ++q) {
+    char c = inline_data[q];
+    if (stops.find(c) != std::string_view::npos) {
+      break;
+    }
+    // "**" and "\\" are markup even inside a url
+    if ((c == '*' || c == '\\') && q + 1 < inline_data.size() &&
+        inline_data[q + 1] == c) {
+      break;
+    }
+  }
+
+  std::string_view url = inline_data.substr(from, q - from);
+  auto unbalanced = [](std::string_view u) {
+    return std::count(u.begin(), u.end(), ')') >
+           std::count(u.begin(), u.end(), '(');
+  };
+  while (!url.empty() && (std::string_view(".,;:!?'\"").find(url.back()) !=
+                              std::string_view::npos ||
+                          (url.back() == ')' && unbalanced(url)))) {
+    url.remove_suffix(1);
+  }
+  return from + url.size();
+}
+
 /*=== Helper Functions ===*/
-void ILexer::heat_the_engine(const std::string &input, size_t s_loc) {
-  _V_ << " [ILexer] Heating The Engine..." << std::endl;
+void ILexer::heat_the_engine(std::string_view input, size_t s_offset) {
   i_tokens.clear();
-  curr_text.clear();
+  arena.reset();
+  out = &arena;
+  curr_text = {};
   pos = 0;
-  loc = s_loc;
+  base_offset = s_offset;
   curr_state = State::NORMAL;
   inline_data = input;
+  outer = nullptr;
+  escaped_at = std::string_view::npos;
   fmt_pos = 0;
-  fmt_loc = s_loc;
   fmt_stack.clear();
-  _V_ << " [ILexer] Engine Heated." << std::endl;
 }
 
-bool ILexer::end() { return pos >= inline_data.size(); }
-
-char ILexer::peek() {
-  if (!end()) {
-    return inline_data[pos];
-  }
-  return inline_data.back();
+size_t ILexer::offset_of(std::string_view text) {
+  return base_offset + (text.data() - inline_data.data());
 }
 
-char ILexer::lookahead(size_t offset) {
-  if (pos + offset < inline_data.size()) {
-    return inline_data[pos + offset];
+inline bool ILexer::end() const { return pos >= inline_data.size(); }
+
+/*
+ * Past the end of our span these read its last char, as if the span was the
+ * whole input. The top level lexer has no outer span and only clamps.
+ */
+inline char ILexer::peek() const { return lookahead(0); }
+
+inline char ILexer::lookahead(size_t offset) const {
+  size_t last = inline_data.size() - 1;
+  if (outer) {
+    last = std::min(last, span_end_within(pos, offset) - 1);
   }
-  return inline_data.back();
+  return inline_data[std::min(pos + offset, last)];
 }
 
-void ILexer::advance(size_t offset) {
-  if (pos + offset <= inline_data.size()) {
-    pos += offset;
+/*
+ * A step past the end is dropped, not clamped. Single steps are only taken
+ * from a byte inside our span and always fit, except the loop's step after
+ * the last byte, which does not matter once the span is over.
+ */
+inline void ILexer::advance(size_t offset) {
+  size_t end = inline_data.size();
+  if (outer && offset > 1) {
+    end = span_end_within(pos, offset);
   }
+  pos += pos + offset <= end ? offset : 0;
 }
 
-void ILexer::add_token(InlineTokenType type, std::optional<std::string> content,
-                       std::optional<std::string> url) {
-  IToken token(type, loc, content, url);
+void ILexer::add_token(InlineTokenType type, size_t offset,
+                       std::optional<std::string_view> content,
+                       std::optional<std::string_view> url) {
+  IToken token(type, offset, content, url);
   i_tokens.push_back(token);
 }
 
+/*
+ * Grows the current text run by the n characters at pos. Runs are always
+ * contiguous in inline_data, so this only widens the view.
+ */
+void ILexer::extend_current_text(size_t n) {
+  if (curr_text.empty()) {
+    curr_text = inline_data.substr(pos, n);
+  } else {
+    curr_text = {curr_text.data(), curr_text.size() + n};
+  }
+}
+
 void ILexer::finalize_current_text() {
-  _V_ << " [ILexer] Finalizing Current State." << std::endl;
+  TRACE(INLINE, "ILexer text at", pos);
   if (!curr_text.empty()) {
-    add_token(InlineTokenType::TEXT, curr_text);
-    curr_text.clear();
+    add_token(InlineTokenType::TEXT, offset_of(curr_text), curr_text);
+    curr_text = {};
   }
 }
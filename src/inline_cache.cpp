@@ -0,0 +1,50 @@
+#include "inline_cache.h"
+#include "trace.h"
+
+/*
+ * Looks text up, a hit moves its entry to the front. A miss tokenizes text
+ * with lexer and, unless the cache is off, keeps a copy of the text and the
+ * tokens, evicting the least recently used entry when full.
+ */
+const ITokenArena &InlineCache::tokenize(std::string_view text,
+                                         ILexer &lexer) {
+  if (capacity == 0) {
+    ++miss_count;
+    return lexer.tokenize_in_place(text);
+  }
+
+  auto it = index.find(text);
+  if (it != index.end()) {
+    ++hit_count;
+    TRACE(INLINE, "InlineCache hit, bytes", text.size());
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->tokens;
+  }
+
+  ++miss_count;
+  evict_to(capacity - 1);
+  entries.push_front({std::string(text), {}});
+  Entry &e = entries.front();
+  // tokenized after the copy is in place, so the views point into it
+  e.tokens = lexer.tokenize(e.text);
+  index.emplace(e.text, entries.begin());
+  return e.tokens;
+}
+
+void InlineCache::set_capacity(size_t n) {
+  capacity = n;
+  evict_to(n);
+}
+
+/* drops every entry, the counters are kept */
+void InlineCache::clear() {
+  index.clear();
+  entries.clear();
+}
+
+void InlineCache::evict_to(size_t n) {
+  while (entries.size() > n) {
+    index.erase(entries.back().text);
+    entries.pop_back();
+  }
+}
@@ -0,0 +1,23 @@
+#include "line_table.h"
+#include "scan.h"
+#include <algorithm>
+
+LineTable::LineTable(std::string_view data) {
+  const char *end = data.data() + data.size();
+  starts.reserve(count_newlines(data.data(), end) + 1);
+  line_starts(data.data(), end, 0, starts);
+}
+
+/*
+ * Line and column of offset. Offsets past the end land on the last line, the
+ * offset of the ENDOF token is the end itself.
+ */
+LinePos LineTable::position(size_t offset) const {
+  size_t line = std::upper_bound(starts.begin(), starts.end(), offset) -
+                starts.begin(); // starts[0] is 0, so at least 1
+  return {line, offset - starts[line - 1] + 1};
+}
+
+size_t LineTable::line(size_t offset) const { return position(offset).line; }
+
+size_t LineTable::line_count() const { return starts.size(); }
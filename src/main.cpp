@@ -1,5 +1,7 @@
 #include "b_lexer.h"
+#include "b_stream_lexer.h"
 #include "error.h"
+#include "globals.h"
 #include "iostream"
 #include "migr_semantic.h"
 #include "migr_structural.h"
@@ -9,15 +11,27 @@
 int main(int argc, char *argv[]) {
   Args args = parse_args(argc, argv);
   try {
-    BLexer blexer(args.filename);
-    blexer.b_tokenize();
     StructuralLayer ll;
-    ll.build_from_tokens(blexer.get_tokens());
+    ll.set_inline_cache_size(args.inline_cache);
+    if (args.filename == "-" && args.jobs == 1) {
+      // stdin is lexed in batches as it arrives, never held whole
+      BStreamLexer slexer(std::cin);
+      ll.build_from_stream(slexer);
+    } else if (args.jobs == 1) {
+      // lex block by block while the tree is built
+      BLexer blexer(args.filename);
+      ll.build_from_stream(blexer, blexer.get_source());
+    } else {
+      BLexer blexer(args.filename);
+      blexer.b_tokenize_parallel(args.jobs);
+      ll.build_from_tokens(blexer.get_tokens(), blexer.get_source());
+    }
     std::ofstream sl_out("tests/structural.json");
 
     ll.print_structural_info(true);
 
     ll.serialize(sl_out);
+    sl_out.close(); // read back below
 
     SemanticLayer sm;
     sm.extract_semantics(ll);
@@ -27,6 +41,7 @@ int main(int argc, char *argv[]) {
 
     std::ofstream sm_out("tests/semantic.json");
     sm.serialize(sm_out);
+    sm_out.close();
 
     std::cout
         << "======= output after deserializing data from generated json ======"
@@ -39,7 +54,11 @@ int main(int argc, char *argv[]) {
     ll.print_structural_info(true);
     sm.print_semantic_info(true);
   } catch (const CNError &e) {
+    trace_dump(std::cerr, 32); // what led up to it
     std::cout << e.format() << std::endl;
   }
+  if (verbose) {
+    trace_dump(std::cerr);
+  }
   return 0;
 }
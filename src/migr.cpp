@@ -1,32 +1,183 @@
 #include "migr.h"
+#include "error.h"
 #include "globals.h"
+#include "hash.h"
 #include <algorithm>
+#include <charconv>
 #include <iostream>
+#include <limits>
 #include <sstream>
 
-size_t MIGRNode::next_id_ = 1;
+NodeId MIGRNode::next_id_ = 1;
+uint64_t MIGRNode::edits_ = 0;
 
 MIGRNode::MIGRNode(MIGRNodeType type, const std::string &c)
-    : type_(type), content_(c), loc_(0), version_(1) {
+    : type_(type), content_(c), offset_(0), version_(1) {
   generate_id();
   update_hash();
 }
 
 /*
- * generates id in format node_${id} and increments the id
+ * takes the next id from the counter, the last NodeId is never handed out so
+ * the counter cannot wrap to no_node
  */
-void MIGRNode::generate_id() { id_ = "node_" + std::to_string(next_id_++); }
+void MIGRNode::generate_id() {
+  if (next_id_ == std::numeric_limits<NodeId>::max()) {
+    throw CNError("out of node ids", 0);
+  }
+  id_ = next_id_++;
+}
+
+void MIGRNode::reserve_id(NodeId id) {
+  if (id >= next_id_) {
+    next_id_ = id == std::numeric_limits<NodeId>::max() ? id : id + 1;
+  }
+}
+
+/*
+ * printed form of an id, node_${id}
+ */
+std::string MIGRNode::id_string(NodeId id) {
+  return "node_" + std::to_string(id);
+}
+
+/*
+ * id of a node_${id} string, as written by id_string
+ */
+NodeId MIGRNode::parse_id(std::string_view id_str) {
+  constexpr std::string_view prefix = "node_";
+  if (id_str.substr(0, prefix.size()) != prefix) {
+    return no_node;
+  }
+  NodeId id{0};
+  for (char c : id_str.substr(prefix.size())) {
+    if (c < '0' || c > '9') {
+      return no_node;
+    }
+    NodeId digit = c - '0';
+    // ids come from a NodeId counter, a bigger one was never made by us
+    if (id > (std::numeric_limits<NodeId>::max() - digit) / 10) {
+      throw CNError("node id out of range: " + std::string(id_str), 0);
+    }
+    id = id * 10 + digit;
+  }
+  return id;
+}
 
 /*
  * Recomputes the content hash of this node.
- * Combines the node's content with its type and hashes the result.
+ * Hashes the node's content with its type as the seed, no temporary string.
  * Used in our code for detecting changes/versioning.
- * note: not perfect yet, does not use perfect hashing
  */
 void MIGRNode::update_hash() {
-  std::hash<std::string> hasher;
-  content_hash_ = std::to_string(
-      hasher(content_ + std::to_string(static_cast<int>(type_))));
+  content_hash_ = hash64(content_, hash_seed + static_cast<uint64_t>(type_));
+  mark_dirty();
+}
+
+/*
+ * Hash of this node and everything below it: the content hash, the attributes
+ * and the subtree hashes of the children in order. Cached per node, only the
+ * nodes marked dirty since the last call are hashed again, so after an edit
+ * that is the path from the edited node to the root.
+ */
+uint64_t MIGRNode::subtree_hash() const {
+  if (!subtree_dirty_) {
+    return subtree_hash_;
+  }
+  uint64_t h = content_hash_;
+  h = hash_combine(h, static_cast<uint64_t>(attrs_.level));
+  h = hash_combine(h, static_cast<uint64_t>(attrs_.link_type));
+  h = hash_combine(h, hash64(attrs_.ref.view()));
+  for (const auto &[k, v] : attrs_.extra) {
+    h = hash_combine(h, hash_combine(hash64(k), hash64(v)));
+  }
+  h = hash_combine(h, children_.size());
+  for (const MIGRNode *child : children_) {
+    if (child) {
+      h = hash_combine(h, child->subtree_hash());
+    }
+  }
+  subtree_hash_ = h;
+  subtree_dirty_ = false;
+  return h;
+}
+
+/*
+ * Marks this node and its ancestors for rehashing. Stops at the first one
+ * already dirty, its ancestors are dirty too. Counted in edits_ either way,
+ * the layers' columns hold views of content_ and rows of children_.
+ */
+void MIGRNode::mark_dirty() {
+  ++edits_;
+  for (MIGRNode *n = this; n && !n->subtree_dirty_; n = n->parent_) {
+    n->subtree_dirty_ = true;
+  }
+}
+
+/*
+ * Sets an attribute by its metadata key. The known keys land in their typed
+ * field, anything else (or a known key on a node type that doesn't carry it)
+ * in the extra list.
+ */
+void MIGRNode::set_attr(std::string_view key, std::string value,
+                        StringPool &pool) {
+  mark_dirty(); // every path below writes attrs_, which is in the hash
+  if (key == "level") {
+    // out of range fails like a non number does, the value goes to extra
+    int level{0};
+    const char *end = value.data() + value.size();
+    auto [ptr, ec] = std::from_chars(value.data(), end, level);
+    if (ec == std::errc{} && ptr == end && level > 0) {
+      attrs_.level = level;
+      return;
+    }
+  } else if (key == "link_type") {
+    if (value == "internal" || value == "external") {
+      attrs_.link_type =
+          value == "external" ? LinkType::EXTERNAL : LinkType::INTERNAL;
+      return;
+    }
+  } else if (!key.empty() && key == ref_key(type_)) {
+    attrs_.ref = pool.intern(value);
+    return;
+  }
+  for (auto &[k, v] : attrs_.extra) {
+    if (k == key) {
+      v = std::move(value);
+      return;
+    }
+  }
+  attrs_.extra.emplace_back(std::string(key), std::move(value));
+}
+
+bool MIGRNode::has_attrs() const {
+  return attrs_.level > 0 || !attrs_.ref.empty() ||
+         attrs_.link_type != LinkType::NONE || !attrs_.extra.empty();
+}
+
+std::string_view MIGRNode::ref_key(MIGRNodeType type) {
+  switch (type) {
+  case MIGRNodeType::LINK:
+  case MIGRNodeType::IMAGE:
+    return "url";
+  case MIGRNodeType::REFERENCE:
+    return "target";
+  case MIGRNodeType::TAG:
+    return "tag_name";
+  default:
+    return "";
+  }
+}
+
+std::string_view MIGRNode::link_type_string(LinkType type) {
+  switch (type) {
+  case LinkType::INTERNAL:
+    return "internal";
+  case LinkType::EXTERNAL:
+    return "external";
+  default:
+    return "";
+  }
 }
 
 /*
@@ -34,12 +185,13 @@ void MIGRNode::update_hash() {
  * If the child pointer is valid, it appends to the children list and sets this
  * node as the parent.
  */
-void MIGRNode::add_child(std::shared_ptr<MIGRNode> child) {
+void MIGRNode::add_child(MIGRNode *child) {
   if (child) {
     children_.push_back(child);
-    child->parent_ = shared_from_this();
+    child->parent_ = this;
+    mark_dirty();
   } else {
-    _V_ << " [MIGRNode] [Warning] Child for id: " << shared_from_this()->id_
+    _V_ << " [MIGRNode] [Warning] Child for id: " << id_string(id_)
         << "Was null when add_child was called on it" << std::endl;
   }
 }
@@ -48,21 +200,22 @@ void MIGRNode::add_child(std::shared_ptr<MIGRNode> child) {
  * Removes a child node based on its ID.
  * Searches the children list and removes any node matching the given ID.
  */
-void MIGRNode::remove_child(const std::string &child_id) {
+void MIGRNode::remove_child(NodeId child_id) {
   children_.erase(
       std::remove_if(children_.begin(), children_.end(),
-                     [&child_id](const std::shared_ptr<MIGRNode> &child) {
+                     [child_id](const MIGRNode *child) {
                        return child && child->id_ == child_id;
                      }),
       children_.end());
+  mark_dirty();
 }
 
 /*
  * Finds a direct child node by ID.
- * Returns a shared_ptr to the child if found, otherwise nullptr.
+ * Returns a pointer to the child if found, otherwise nullptr.
  */
-std::shared_ptr<MIGRNode> MIGRNode::find_child(const std::string &id) {
-  for (auto &child : children_) {
+MIGRNode *MIGRNode::find_child(NodeId id) {
+  for (MIGRNode *child : children_) {
     if (child && child->id_ == id) {
       return child;
     }
@@ -89,9 +242,9 @@ void MIGRNode::update_content(const std::string &new_content) {
 std::string MIGRNode::to_string() const {
   std::ostringstream oss;
   oss << "MIGRNode:\n"
-      << "id: " << id_ << "\n"
+      << "id: " << id_string(id_) << "\n"
       << "type: " << static_cast<int>(type_) << "\n"
-      << "loc: " << loc_ << "\n"
+      << "offset: " << offset_ << "\n"
       << "content: "
       << (content_.empty()
               ? "[empty]"
@@ -116,3 +269,116 @@ void MIGRNode::print_tree(int depth) const {
     }
   }
 }
+
+/*
+ * Fills the columns from nodes, one row per node in id order. Parent and
+ * child links are only kept between nodes of the map.
+ */
+void NodeColumns::build(const NodeMap<MIGRNode *> &nodes) {
+  clear();
+  edits = MIGRNode::edits();
+  NodeMap<uint32_t> row_of; // row + 1, 0 is the empty slot
+  for (MIGRNode *n : nodes.values()) {
+    row_of[n->id_] = static_cast<uint32_t>(size()) + 1;
+    id.push_back(n->id_);
+    type.push_back(n->type_);
+    offset.push_back(n->offset_);
+    content.push_back(n->content_);
+    node.push_back(n);
+  }
+
+  parent.assign(size(), npos_row);
+  first_child.assign(size(), npos_row);
+  next_sibling.assign(size(), npos_row);
+  for (uint32_t r{0}; r < size(); ++r) {
+    uint32_t prev = npos_row;
+    for (const MIGRNode *child : node[r]->children_) {
+      const uint32_t *c = child ? row_of.find(child->id_) : nullptr;
+      if (!c) {
+        continue;
+      }
+      parent[*c - 1] = r;
+      (prev == npos_row ? first_child[r] : next_sibling[prev]) = *c - 1;
+      prev = *c - 1;
+    }
+  }
+}
+
+void NodeColumns::clear() {
+  id.clear();
+  type.clear();
+  offset.clear();
+  parent.clear();
+  first_child.clear();
+  next_sibling.clear();
+  content.clear();
+  node.clear();
+}
+
+/*
+ * Rows matching a type and an offset range. Only the type and offset arrays
+ * are read, and the three compares are combined without branching.
+ */
+std::vector<uint32_t> NodeColumns::rows_of(MIGRNodeType t, size_t begin,
+                                           size_t end) const {
+  std::vector<uint32_t> rows;
+  const MIGRNodeType *ty = type.data();
+  const size_t *off = offset.data();
+  for (uint32_t r{0}; r < size(); ++r) {
+    bool hit = (ty[r] == t) & (off[r] >= begin) & (off[r] < end);
+    if (hit) {
+      rows.push_back(r);
+    }
+  }
+  return rows;
+}
+
+/*
+ * Adds node to the list of its type, keeping it sorted by id. Adding a node
+ * that is already there does nothing.
+ */
+void NodeTypeIndex::add(MIGRNode *node) {
+  auto &list = lists[static_cast<size_t>(node->type_)];
+  auto by_id = [](const MIGRNode *n, NodeId id) { return n->id_ < id; };
+  if (list.empty() || list.back()->id_ < node->id_) {
+    list.push_back(node);
+    return;
+  }
+  auto it = std::lower_bound(list.begin(), list.end(), node->id_, by_id);
+  if (it == list.end() || *it != node) {
+    list.insert(it, node);
+  }
+}
+
+void NodeTypeIndex::remove(const MIGRNode *node) {
+  auto &list = lists[static_cast<size_t>(node->type_)];
+  auto by_id = [](const MIGRNode *n, NodeId id) { return n->id_ < id; };
+  auto it = std::lower_bound(list.begin(), list.end(), node->id_, by_id);
+  if (it != list.end() && *it == node) {
+    list.erase(it);
+  }
+}
+
+void NodeTypeIndex::clear() {
+  for (auto &list : lists) {
+    list.clear();
+  }
+}
+
+size_t NodeTypeIndex::size() const {
+  size_t n{0};
+  for (const auto &list : lists) {
+    n += list.size();
+  }
+  return n;
+}
+
+/*
+ * Fills the lists from a node map, which is already in id order.
+ */
+void NodeTypeIndex::build(const NodeMap<MIGRNode *> &nodes) {
+  clear();
+  for (MIGRNode *n : nodes.values()) {
+    lists[static_cast<size_t>(n->type_)].push_back(n);
+  }
+}
@@ -13,9 +13,15 @@
  * Adds a node to the semantic_nodes map keyed by node id.
  * Meanwhile Ignoring null pointers.
  */
-void SemanticLayer::add_node(std::shared_ptr<MIGRNode> node) {
+void SemanticLayer::add_node(MIGRNode *node) {
   if (node) {
-    semantic_nodes_[node->id_] = node;
+    MIGRNode *&slot = semantic_nodes_[node->id_];
+    if (slot && slot != node) {
+      by_type_.remove(slot);
+    }
+    slot = node;
+    by_type_.add(node);
+    columns_dirty_ = true;
   }
 }
 
@@ -26,17 +32,14 @@ void SemanticLayer::add_node(std::shared_ptr<MIGRNode> node) {
  * Clears references from the reference cache.
  * Rebuilds the backlink index after removal.
  */
-void SemanticLayer::remove_node(const std::string &node_id) {
-  auto it = semantic_nodes_.find(node_id);
-  if (it == semantic_nodes_.end()) {
+void SemanticLayer::remove_node(NodeId node_id) {
+  if (!semantic_nodes_.contains(node_id)) {
     return;
   }
 
-  auto node = it->second;
-
   // now remove all edges involving this node.
   edges_.erase(std::remove_if(edges_.begin(), edges_.end(),
-                              [&node_id](const SemanticEdge &e) {
+                              [node_id](const SemanticEdge &e) {
                                 return e.source_id == node_id ||
                                        e.target_id == node_id;
                               }),
@@ -53,7 +56,9 @@ void SemanticLayer::remove_node(const std::string &node_id) {
   }
 
   // removing from storage
-  semantic_nodes_.erase(it);
+  by_type_.remove(*semantic_nodes_.find(node_id));
+  semantic_nodes_.erase(node_id);
+  columns_dirty_ = true;
 
   build_edge_indexes();
 }
@@ -61,15 +66,13 @@ void SemanticLayer::remove_node(const std::string &node_id) {
 /*
  * Takes a predicate (true/false) function as input
  * Queries nodes by using that function.
- * Returns a vector of shared_ptrs containing nodes matching the predicate.
+ * Returns a vector of pointers to the nodes matching the predicate.
  */
-std::vector<std::shared_ptr<MIGRNode>> SemanticLayer::query_nodes(
+std::vector<MIGRNode *> SemanticLayer::query_nodes(
     std::function<bool(const MIGRNode &)> predicate) const {
-  std::vector<std::shared_ptr<MIGRNode>> query_results;
-  query_results.reserve(semantic_nodes_.size() / 2); // educated guess
-
-  for (const auto &[_, node] : semantic_nodes_) {
-    if (node && predicate(*node)) {
+  std::vector<MIGRNode *> query_results;
+  for (const auto &node : semantic_nodes_.values()) {
+    if (predicate(*node)) {
       query_results.push_back(node);
     }
   }
@@ -77,11 +80,34 @@ std::vector<std::shared_ptr<MIGRNode>> SemanticLayer::query_nodes(
   return query_results;
 }
 
+/*
+ * Columns of every node of the layer, rebuilt from the node map when a node
+ * was added, removed or edited since the last call.
+ */
+const NodeColumns &SemanticLayer::columns() const {
+  if (columns_dirty_ || columns_.edits != MIGRNode::edits()) {
+    columns_.build(semantic_nodes_);
+    columns_dirty_ = false;
+  }
+  return columns_;
+}
+
+/*
+ * Nodes of a type, in id order.
+ */
+std::vector<MIGRNode *> SemanticLayer::scan(MIGRNodeType type) const {
+  const NodeColumns &cols = columns();
+  std::vector<MIGRNode *> results;
+  for (uint32_t r : cols.rows_of(type)) {
+    results.push_back(cols.node[r]);
+  }
+  return results;
+}
+
 /*
  * Helper function to get all neighbours of a node
  */
-std::vector<std::shared_ptr<MIGRNode>>
-SemanticLayer::get_neighbours(const std::string &node_id) const {
+std::vector<MIGRNode *> SemanticLayer::get_neighbours(NodeId node_id) const {
   return get_semantic_targets(node_id);
 }
 
@@ -142,7 +168,11 @@ void SemanticLayer::deserialize(std::istream &in) {
 
   const auto &layer = doc["semantic_layer"];
 
-  semantic_nodes_ = DeserializationEngine::read_nodes(layer);
+  reset();
+  semantic_nodes_ =
+      DeserializationEngine::read_nodes(layer, arena_, *strings_);
+  by_type_.build(semantic_nodes_);
+  columns_dirty_ = true;
   edges_ = DeserializationEngine::read_edges<SemanticEdge>(layer);
 
   outgoing_edge_index_ =
@@ -150,8 +180,9 @@ void SemanticLayer::deserialize(std::istream &in) {
   incoming_edge_index_ =
       DeserializationEngine::read_index(layer, "incoming_index");
 
-  reference_cache_ = DeserializationEngine::read_map(layer, "ref_cache");
-  tag_cache_ = DeserializationEngine::read_map(layer, "tag_cache");
+  reference_cache_ =
+      DeserializationEngine::read_map(layer, "ref_cache", *strings_);
+  tag_cache_ = DeserializationEngine::read_map(layer, "tag_cache", *strings_);
 }
 
 //-----------------------------//
@@ -173,12 +204,16 @@ void SemanticLayer::extract_semantics(const StructuralLayer &structural) {
   }
 
   reset();
-
-  auto link_nodes = structural.query_nodes(
-      [](const MIGRNode &node) { return node.type_ == MIGRNodeType::LINK; });
-
-  for (auto &node : link_nodes) {
-    add_node(node);
+  // the LINK nodes' urls are already interned there, handles compare equal
+  strings_ = structural.get_string_pool();
+
+  // own copies, the structural arena may be cleared while this layer lives
+  for (MIGRNode *node : structural.nodes_of_type(MIGRNodeType::LINK)) {
+    MIGRNode *link = arena_.make(*node);
+    link->parent_ = nullptr;
+    link->children_.clear();
+    link->mark_dirty();
+    add_node(link);
   }
 
   extract_links(root);
@@ -194,8 +229,8 @@ void SemanticLayer::extract_semantics(const StructuralLayer &structural) {
  * Updates source node’s semantic links, so that this edge is there.
  * Registers the edge with type and relation label.
  */
-void SemanticLayer::add_semantic_edge(const std::shared_ptr<MIGRNode> &source,
-                                      const std::shared_ptr<MIGRNode> &target,
+void SemanticLayer::add_semantic_edge(MIGRNode *source,
+                                      MIGRNode *target,
                                       MIGREdgeType edge_type,
                                       const std::string &relation_label) {
   size_t edge_idx = edges_.size();
@@ -209,22 +244,9 @@ void SemanticLayer::add_semantic_edge(const std::shared_ptr<MIGRNode> &source,
  * Finds all nodes linking back to a target node by its id.
  * It utilizes backlink index for efficient lookup.
  */
-std::vector<std::shared_ptr<MIGRNode>>
-SemanticLayer::find_backlinks(const std::string &target_id) const {
-  std::vector<std::shared_ptr<MIGRNode>> results;
-
-  auto it = incoming_edge_index_.find(target_id);
-  if (it != incoming_edge_index_.end()) {
-    results.reserve(it->second.size());
-    for (size_t edge_idx : it->second) {
-      const auto &edge = edges_[edge_idx];
-      auto node_it = semantic_nodes_.find(edge.source_id);
-      if (node_it != semantic_nodes_.end()) {
-        results.push_back(node_it->second);
-      }
-    }
-  }
-  return results;
+std::vector<MIGRNode *> SemanticLayer::find_backlinks(NodeId target_id) const {
+  auto backlinks = backlinks_view(target_id);
+  return {backlinks.begin(), backlinks.end()};
 }
 
 /*
@@ -232,18 +254,19 @@ SemanticLayer::find_backlinks(const std::string &target_id) const {
  * Returns vector that has nodes with tag and also it has nodes referencing
  * those tags.
  */
-std::vector<std::shared_ptr<MIGRNode>>
+std::vector<MIGRNode *>
 SemanticLayer::search_tag(const std::string &tag) const {
-  std::vector<std::shared_ptr<MIGRNode>> results;
-
-  auto tag_nodes = query_nodes([&](const MIGRNode &node) {
-    return node.type_ == MIGRNodeType::TAG && node.content_ == tag;
-  });
+  std::vector<MIGRNode *> results;
 
-  for (const auto &tgn : tag_nodes) {
-    results.push_back(tgn);
-    auto tgbs = find_backlinks(tgn->id_);
-    results.insert(results.end(), tgbs.begin(), tgbs.end());
+  const NodeColumns &cols = columns();
+  for (uint32_t r : cols.rows_of(MIGRNodeType::TAG)) {
+    if (cols.content[r] != tag) {
+      continue;
+    }
+    results.push_back(cols.node[r]);
+    for (MIGRNode *bl : backlinks_view(cols.id[r])) {
+      results.push_back(bl);
+    }
   }
   return results;
 }
@@ -251,21 +274,22 @@ SemanticLayer::search_tag(const std::string &tag) const {
 /*
  * Finds all reference nodes targeting a given name and their backlinks.
  */
-std::vector<std::shared_ptr<MIGRNode>>
+std::vector<MIGRNode *>
 SemanticLayer::find_all_links_to_target(const std::string &target_name) const {
-  std::vector<std::shared_ptr<MIGRNode>> results;
+  std::vector<MIGRNode *> results;
 
-  auto ref_nodes = query_nodes([&](const MIGRNode &n) {
-    if (n.type_ != MIGRNodeType::REFERENCE) {
-      return false;
-    }
-    auto it = n.metadata_.find("target");
-    return it != n.metadata_.end() && it->second == target_name;
-  });
+  InternedStr target = strings_->find(target_name);
+  if (target.empty()) {
+    return results; // never interned, so no reference has it
+  }
 
-  for (const auto &ref : ref_nodes) {
-    auto bls = find_backlinks(ref->id_);
-    results.insert(results.end(), bls.begin(), bls.end());
+  for (MIGRNode *ref : nodes_of_type(MIGRNodeType::REFERENCE)) {
+    if (ref->attrs_.ref != target) {
+      continue;
+    }
+    for (MIGRNode *bl : backlinks_view(ref->id_)) {
+      results.push_back(bl);
+    }
   }
   return results;
 }
@@ -278,78 +302,38 @@ SemanticLayer::find_all_links_to_target(const std::string &target_name) const {
  * Returns all target nodes that the give source node links to.
  * Uses outgoing edge index for O(1) lookup
  */
-std::vector<std::shared_ptr<MIGRNode>>
-SemanticLayer::get_semantic_targets(const std::string &source_id) const {
-  std::vector<std::shared_ptr<MIGRNode>> targets;
-
-  auto it = outgoing_edge_index_.find(source_id);
-  if (it != outgoing_edge_index_.end()) {
-    targets.reserve(it->second.size());
-    for (size_t idx : it->second) {
-      const auto &edge = edges_[idx];
-      auto target_it = semantic_nodes_.find(edge.target_id);
-      if (target_it != semantic_nodes_.end()) {
-        targets.push_back(target_it->second);
-      }
-    }
-  }
-  return targets;
+std::vector<MIGRNode *>
+SemanticLayer::get_semantic_targets(NodeId source_id) const {
+  auto targets = semantic_targets_view(source_id);
+  return {targets.begin(), targets.end()};
 }
 
 /*
  * Returns all source nodes that link to given target node.
  * Uses incoming edge index for O(1) lookup
  */
-std::vector<std::shared_ptr<MIGRNode>>
-SemanticLayer::get_semantic_sources(const std::string &target_id) const {
-  std::vector<std::shared_ptr<MIGRNode>> sources;
-
-  auto it = incoming_edge_index_.find(target_id);
-  if (it != incoming_edge_index_.end()) {
-    sources.reserve(it->second.size());
-    for (size_t idx : it->second) {
-      const auto &edge = edges_[idx];
-      auto source_it = semantic_nodes_.find(edge.source_id);
-      if (source_it != semantic_nodes_.end()) {
-        sources.push_back(source_it->second);
-      }
-    }
-  }
-  return sources;
+std::vector<MIGRNode *>
+SemanticLayer::get_semantic_sources(NodeId target_id) const {
+  auto sources = semantic_sources_view(target_id);
+  return {sources.begin(), sources.end()};
 }
 
 /*
  * Return all edges originating from a given semantic node.
  */
 std::vector<SemanticEdge>
-SemanticLayer::get_edges_from_node(const std::string &node_id) const {
-  std::vector<SemanticEdge> result;
-
-  auto it = outgoing_edge_index_.find(node_id);
-  if (it != outgoing_edge_index_.end()) {
-    result.reserve(it->second.size());
-    for (size_t idx : it->second) {
-      result.push_back(edges_[idx]);
-    }
-  }
-  return result;
+SemanticLayer::get_edges_from_node(NodeId node_id) const {
+  auto edges = edges_from_view(node_id);
+  return {edges.begin(), edges.end()};
 }
 
 /*
  * Return all edges going into a given semantic node.
  */
 std::vector<SemanticEdge>
-SemanticLayer::get_edges_to_node(const std::string &node_id) const {
-  std::vector<SemanticEdge> result;
-
-  auto it = incoming_edge_index_.find(node_id);
-  if (it != incoming_edge_index_.end()) {
-    result.reserve(it->second.size());
-    for (size_t idx : it->second) {
-      result.push_back(edges_[idx]);
-    }
-  }
-  return result;
+SemanticLayer::get_edges_to_node(NodeId node_id) const {
+  auto edges = edges_to_view(node_id);
+  return {edges.begin(), edges.end()};
 }
 
 //-------------------//
@@ -364,14 +348,11 @@ SemanticLayer::get_edges_to_node(const std::string &node_id) const {
  */
 void SemanticLayer::print_semantic_info(bool detailed) const {
   std::cout << "=== semantic info ===" << std::endl;
-  std::cout << "Total Nodes: " << semantic_nodes_.size() << std::endl;
+  std::cout << "Total Nodes: " << by_type_.size() << std::endl;
   std::cout << "Total Edges: " << edges_.size() << std::endl;
 
-  auto ref_nodes = query_nodes([](const MIGRNode &node) {
-    return node.type_ == MIGRNodeType::REFERENCE;
-  });
-  auto tag_nodes = query_nodes(
-      [](const MIGRNode &node) { return node.type_ == MIGRNodeType::TAG; });
+  auto ref_nodes = nodes_of_type(MIGRNodeType::REFERENCE);
+  auto tag_nodes = nodes_of_type(MIGRNodeType::TAG);
 
   std::cout << "Reference nodes: " << ref_nodes.size() << std::endl;
   std::cout << "Tag Nodes: " << tag_nodes.size() << std::endl;
@@ -384,22 +365,22 @@ void SemanticLayer::print_semantic_info(bool detailed) const {
   if (!ref_nodes.empty()) {
     std::cout << "\n--- References ---" << std::endl;
     for (const auto &ref : ref_nodes) {
-      auto target_it = ref->metadata_.find("target");
-      auto type_it = ref->metadata_.find("link_type");
-
-      std::string target =
-          target_it != ref->metadata_.end() ? target_it->second : "[no target]";
-      std::string link_type =
-          type_it != ref->metadata_.end() ? type_it->second : "[unknown]";
+      std::string_view target =
+          !ref->attrs_.ref.empty() ? ref->attrs_.ref.view() : "[no target]";
+      std::string link_type = ref->attrs_.link_type != LinkType::NONE
+                                  ? std::string(MIGRNode::link_type_string(
+                                        ref->attrs_.link_type))
+                                  : "[unknown]";
 
-      std::cout << "\nREF: " << ref->id_ << " -> '" << target << "' ("
-                << link_type << ")" << std::endl;
+      std::cout << "\nREF: " << MIGRNode::id_string(ref->id_) << " -> '"
+                << target << "' (" << link_type << ")" << std::endl;
 
-      auto backlinks = find_backlinks(ref->id_);
+      auto backlinks = backlinks_view(ref->id_);
       if (!backlinks.empty()) {
         std::cout << "  Backlinks:" << std::endl;
         for (const auto &bl : backlinks) {
-          std::cout << "    " << bl->id_ << " <- " << bl->content_ << std::endl;
+          std::cout << "    " << MIGRNode::id_string(bl->id_) << " <- "
+                    << bl->content_ << std::endl;
         }
       }
     }
@@ -408,19 +389,18 @@ void SemanticLayer::print_semantic_info(bool detailed) const {
   if (!tag_nodes.empty()) {
     std::cout << "\n--- Tags ---" << std::endl;
     for (const auto &tag : tag_nodes) {
-      auto tag_name_it = tag->metadata_.find("tag_name");
-      std::string tag_name = tag_name_it != tag->metadata_.end()
-                                 ? tag_name_it->second
-                                 : "[no name]";
+      std::string_view tag_name =
+          !tag->attrs_.ref.empty() ? tag->attrs_.ref.view() : "[no name]";
 
-      std::cout << "\nTAG: " << tag->id_ << " -> '#" << tag_name << "'"
-                << std::endl;
+      std::cout << "\nTAG: " << MIGRNode::id_string(tag->id_) << " -> '#"
+                << tag_name << "'" << std::endl;
 
-      auto backlinks = find_backlinks(tag->id_);
+      auto backlinks = backlinks_view(tag->id_);
       if (!backlinks.empty()) {
         std::cout << "  Tagged by:" << std::endl;
         for (const auto &bl : backlinks) {
-          std::cout << "    " << bl->id_ << " <- " << bl->content_ << std::endl;
+          std::cout << "    " << MIGRNode::id_string(bl->id_) << " <- "
+                    << bl->content_ << std::endl;
         }
       }
     }
@@ -438,6 +418,9 @@ void SemanticLayer::print_semantic_info(bool detailed) const {
  */
 void SemanticLayer::reset() {
   semantic_nodes_.clear();
+  by_type_.clear();
+  columns_dirty_ = true;
+  arena_.clear();
   edges_.clear();
   incoming_edge_index_.clear();
   outgoing_edge_index_.clear();
@@ -450,18 +433,17 @@ void SemanticLayer::reset() {
  * Processes LINK type nodes, skips tag links (starting with '#').
  * Adds semantic edges from link nodes to reference nodes.
  */
-void SemanticLayer::extract_links(std::shared_ptr<MIGRNode> node) {
+void SemanticLayer::extract_links(MIGRNode *node) {
   if (!node) {
     return;
   }
 
   if (node->type_ == MIGRNodeType::LINK) {
-    auto url_it = node->metadata_.find("url");
-    if (url_it != node->metadata_.end()) {
-      std::string target_url = url_it->second;
+    if (!node->attrs_.ref.empty()) {
+      InternedStr target_url = node->attrs_.ref;
 
       // skipping tag linke [[#tag]]
-      if (!target_url.empty() && target_url[0] == '#') {
+      if (target_url.view()[0] == '#') {
         return;
       }
 
@@ -483,19 +465,18 @@ void SemanticLayer::extract_links(std::shared_ptr<MIGRNode> node) {
  * Processes LINK nodes with URLs starting with '#'.
  * Adds semantic edges between the linking node and tag node.
  */
-void SemanticLayer::extract_tags(std::shared_ptr<MIGRNode> node) {
+void SemanticLayer::extract_tags(MIGRNode *node) {
   if (!node)
     return;
 
   // let's do this: tag will be like this [[#tag]] Creole-style tag links
   if (node->type_ == MIGRNodeType::LINK) {
-    auto url_it = node->metadata_.find("url");
-    if (url_it != node->metadata_.end()) {
-      std::string url = url_it->second;
+    if (!node->attrs_.ref.empty()) {
+      std::string_view url = node->attrs_.ref.view();
 
       // confirming that it is a tag link and processing
-      if (!url.empty() && url[0] == '#') {
-        std::string tag_name = url.substr(1);
+      if (url[0] == '#') {
+        InternedStr tag_name = strings_->intern(url.substr(1));
 
         auto tag_node = get_or_create_tag_node(tag_name);
 
@@ -529,13 +510,13 @@ void SemanticLayer::build_edge_indexes() {
 
 /*
  * Based on whether the target string starts with "http://" or "https://".
- * It classifies a link target as "external" or "internal".
+ * It classifies a link target as external or internal.
  */
-std::string SemanticLayer::classify_link_type(const std::string &target) const {
-  if (target.find("http://") == 0 || target.find("https://") == 0) {
-    return "external";
+LinkType SemanticLayer::classify_link_type(std::string_view target) const {
+  if (target.starts_with("http://") || target.starts_with("https://")) {
+    return LinkType::EXTERNAL;
   }
-  return "internal";
+  return LinkType::INTERNAL;
 }
 
 //------------------------//
@@ -547,21 +528,20 @@ std::string SemanticLayer::classify_link_type(const std::string &target) const {
  * otherwise creates new one.
  * Then Caches that nodes to prevent duplicates.
  */
-std::shared_ptr<MIGRNode>
-SemanticLayer::get_or_create_reference_node(const std::string &target) {
+MIGRNode *SemanticLayer::get_or_create_reference_node(InternedStr target) {
   // checking cache first
   auto cache_it = reference_cache_.find(target);
   if (cache_it != reference_cache_.end()) {
-    auto node_it = semantic_nodes_.find(cache_it->second);
-    if (node_it != semantic_nodes_.end()) {
-      return node_it->second;
+    if (auto node = semantic_nodes_.find(cache_it->second)) {
+      return *node;
     }
   }
 
   // creating new ref node
-  auto ref_node = std::make_shared<MIGRNode>(MIGRNodeType::REFERENCE, target);
-  ref_node->metadata_["target"] = target;
-  ref_node->metadata_["link_type"] = classify_link_type(target);
+  MIGRNode *ref_node =
+      arena_.make(MIGRNodeType::REFERENCE, std::string(target.view()));
+  ref_node->attrs_.ref = target;
+  ref_node->attrs_.link_type = classify_link_type(target.view());
 
   add_node(ref_node);
   reference_cache_[target] = ref_node->id_;
@@ -574,20 +554,19 @@ SemanticLayer::get_or_create_reference_node(const std::string &target) {
  * otherwise creates new one.
  * Then Caches that nodes to prevent duplicates.
  */
-std::shared_ptr<MIGRNode>
-SemanticLayer::get_or_create_tag_node(const std::string &tag_name) {
+MIGRNode *SemanticLayer::get_or_create_tag_node(InternedStr tag_name) {
   // checking if already exists in cache
   auto cache_it = tag_cache_.find(tag_name);
   if (cache_it != tag_cache_.end()) {
-    auto node_it = semantic_nodes_.find(cache_it->second);
-    if (node_it != semantic_nodes_.end()) {
-      return node_it->second;
+    if (auto node = semantic_nodes_.find(cache_it->second)) {
+      return *node;
     }
   }
 
   // creating new tagnode
-  auto tag_node = std::make_shared<MIGRNode>(MIGRNodeType::TAG, tag_name);
-  tag_node->metadata_["tag_name"] = tag_name;
+  MIGRNode *tag_node =
+      arena_.make(MIGRNodeType::TAG, std::string(tag_name.view()));
+  tag_node->attrs_.ref = tag_name;
   add_node(tag_node);
   tag_cache_[tag_name] = tag_node->id_;
   return tag_node;
@@ -8,9 +8,10 @@
 #include <string>
 
 StructuralLayer::StructuralLayer()
-    : recovery_strategy_(RecoveryStrategy::ATTACH_TO_PARENT) {
-  root_ = std::make_shared<MIGRNode>(MIGRNodeType::DOCUMENT_ROOT);
-  nodes_[root_->id_] = root_;
+    : strings_(std::make_shared<StringPool>()),
+      recovery_strategy_(RecoveryStrategy::ATTACH_TO_PARENT) {
+  root_ = make_node(MIGRNodeType::DOCUMENT_ROOT);
+  add_node(root_);
   parent_stack_.push(root_);
 }
 
@@ -23,9 +24,15 @@ StructuralLayer::StructuralLayer()
  * Inserts or overwrites based on node's unique id.
  * Does nothing if the node pointer is null.
  */
-void StructuralLayer::add_node(std::shared_ptr<MIGRNode> node) {
+void StructuralLayer::add_node(MIGRNode *node) {
   if (node) {
-    nodes_[node->id_] = node;
+    MIGRNode *&slot = nodes_[node->id_];
+    if (slot && slot != node) {
+      by_type_.remove(slot);
+    }
+    slot = node;
+    by_type_.add(node);
+    columns_dirty_ = true;
   }
 }
 
@@ -34,28 +41,27 @@ void StructuralLayer::add_node(std::shared_ptr<MIGRNode> node) {
  * If node exists, removes it from its parent’s children list if any.
  * Then erases node from the internal nodes map.
  */
-void StructuralLayer::remove_node(const std::string &node_id) {
-  auto it = nodes_.find(node_id);
-  if (it != nodes_.end()) {
-    auto node = it->second;
-    // safely accessing std::shared_ptr of std::weak_ptr parent
-    if (auto parent_ptr = node->parent_.lock()) {
-      parent_ptr->remove_child(node_id);
+void StructuralLayer::remove_node(NodeId node_id) {
+  if (auto node = nodes_.find(node_id)) {
+    if (MIGRNode *parent = (*node)->parent_) {
+      parent->remove_child(node_id);
     }
-    nodes_.erase(it);
+    by_type_.remove(*node);
+    nodes_.erase(node_id);
+    columns_dirty_ = true;
   }
 }
 
 /*
  * Takes a predicate (true/false) function as input
  * Queries nodes by using that function.
- * Returns a vector of shared_ptrs containing nodes matching the predicate.
+ * Returns a vector of pointers to the nodes matching the predicate.
  */
-std::vector<std::shared_ptr<MIGRNode>> StructuralLayer::query_nodes(
+std::vector<MIGRNode *> StructuralLayer::query_nodes(
     std::function<bool(const MIGRNode &)> predicate) const {
-  std::vector<std::shared_ptr<MIGRNode>> query_results;
-  for (const auto &[_, node] : nodes_) {
-    if (node && predicate(*node)) {
+  std::vector<MIGRNode *> query_results;
+  for (const auto &node : nodes_.values()) {
+    if (predicate(*node)) {
       query_results.push_back(node);
     }
   }
@@ -65,11 +71,9 @@ std::vector<std::shared_ptr<MIGRNode>> StructuralLayer::query_nodes(
 /*
  * Helper function to get all neighbours of a node
  */
-std::vector<std::shared_ptr<MIGRNode>>
-StructuralLayer::get_neighbours(const std::string &node_id) const {
-  auto it = nodes_.find(node_id);
-  return it != nodes_.end() ? it->second->children_
-                            : std::vector<std::shared_ptr<MIGRNode>>{};
+std::vector<MIGRNode *> StructuralLayer::get_neighbours(NodeId node_id) const {
+  auto node = nodes_.find(node_id);
+  return node ? (*node)->children_ : std::vector<MIGRNode *>{};
 }
 
 /*
@@ -88,7 +92,7 @@ void StructuralLayer::serialize(std::ostream &out) const {
   writer.Key("version");
   writer.String("1.0");
   writer.Key("root");
-  writer.String(root_ ? root_->id_.c_str() : "");
+  writer.String(root_ ? MIGRNode::id_string(root_->id_).c_str() : "");
 
   SerialzationEngine::write_nodes(writer, nodes_);
 
@@ -100,6 +104,7 @@ void StructuralLayer::serialize(std::ostream &out) const {
 
 /*
  * Deserializes the json data, into structural layer nodes
+ * The layer's current nodes are dropped with their arena.
  */
 void StructuralLayer::deserialize(std::istream &in) {
   std::string json_data((std::istreambuf_iterator<char>(in)),
@@ -120,13 +125,25 @@ void StructuralLayer::deserialize(std::istream &in) {
 
   const auto &layer = doc["structural_layer"];
 
-  nodes_ = DeserializationEngine::read_nodes(layer);
+  parent_stack_ = {};
+  list_stack_ = {};
+  root_ = nullptr;
+  // emptied first, a bad id below throws and must not leave old pointers
+  nodes_.clear();
+  by_type_.clear();
+  columns_dirty_ = true;
+  arena_.clear();
+  nodes_ = DeserializationEngine::read_nodes(layer, arena_, *strings_);
+  by_type_.build(nodes_);
 
   DeserializationEngine::build_hieratchy(layer, nodes_);
 
   if (layer.HasMember("root")) {
-    std::string root_id = layer["root"].GetString();
-    root_ = nodes_[root_id];
+    auto root = nodes_.find(MIGRNode::parse_id(layer["root"].GetString()));
+    root_ = root ? *root : nullptr;
+  }
+  if (root_) {
+    parent_stack_.push(root_);
   }
 }
 
@@ -136,74 +153,158 @@ void StructuralLayer::deserialize(std::istream &in) {
  * Handles list context transitions and error recovery per configured strategy.
  * Collects errors encountered during building
  */
-void StructuralLayer::build_from_tokens(const std::vector<BToken> &tokens) {
+void StructuralLayer::build_from_tokens(
+    const std::vector<BToken> &tokens,
+    std::shared_ptr<const CreoleSource> source) {
   clear_errors();
+  source_ = std::move(source);
 
   _V_ << " [StructuralLayer] Building Structural Layer From Tokens..."
       << std::endl;
   for (size_t i{0}; i < tokens.size(); ++i) {
-    const auto &token = tokens[i];
+    process_token(tokens[i], i);
+  }
+  finish_build();
+}
 
-    // break out of list context for non list items
-    if (in_list_context() && token.type != BlockTokenType::ULISTITEM &&
-        token.type != BlockTokenType::OLISTITEM) {
-      while (in_list_context()) {
-        exit_list_context();
-      }
+/*
+ * Same as build_from_tokens, but pulls the tokens one at a time from a lexer
+ * (BLexer::next_token, BStreamLexer), so lexing and building overlap and the
+ * token vector is never materialized.
+ */
+void StructuralLayer::build_from_stream(
+    BTokenSource &tokens, std::shared_ptr<const CreoleSource> source) {
+  clear_errors();
+  source_ = std::move(source);
+
+  _V_ << " [StructuralLayer] Building Structural Layer From Token Stream..."
+      << std::endl;
+  size_t i{0};
+  for (BToken &token : tokens) {
+    process_token(token, i++);
+  }
+  finish_build();
+}
+
+/*
+ * Adds the node(s) of a single block token, i is its index in the stream.
+ */
+void StructuralLayer::process_token(const BToken &token, size_t i) {
+  // break out of list context for non list items
+  if (in_list_context() && token.type != BlockTokenType::ULISTITEM &&
+      token.type != BlockTokenType::OLISTITEM) {
+    while (in_list_context()) {
+      exit_list_context();
     }
+  }
 
-    try {
-      switch (token.type) {
-      case BlockTokenType::HEADING:
-        process_heading_token(token);
-        break;
-      case BlockTokenType::PARAGRAPH:
-        process_paragraph_token(token);
-        break;
-      case BlockTokenType::ULISTITEM:
-        process_ulist_token(token);
-        break;
-      case BlockTokenType::OLISTITEM:
-        process_olist_token(token);
-        break;
-      case BlockTokenType::HORIZONTALRULE:
-        process_horizontal_rule_token(token);
-        break;
-      case BlockTokenType::VERBATIMBLOCK:
-        process_verbatim_token(token);
-        break;
-      case BlockTokenType::IMAGE:
-        process_image_token(token);
-        break;
-      case BlockTokenType::NEWLINE:
-        process_newline_token(token);
-        break;
-      default:
-        handle_error("Unknown block token type", i);
-        if (!attempt_recovery(token)) {
-          throw MIGRError("Failed to recover from unkown token", i, "skip");
-        }
-        break;
-      }
-    } catch (const MIGRError &e) {
-      errors_.push_back(e);
-      if (e.get_severity() == MIGRError::Severity::FATAL) {
-        throw;
+  try {
+    switch (token.type) {
+    case BlockTokenType::HEADING:
+      process_heading_token(token);
+      break;
+    case BlockTokenType::PARAGRAPH:
+      process_paragraph_token(token);
+      break;
+    case BlockTokenType::ULISTITEM:
+      process_ulist_token(token);
+      break;
+    case BlockTokenType::OLISTITEM:
+      process_olist_token(token);
+      break;
+    case BlockTokenType::HORIZONTALRULE:
+      process_horizontal_rule_token(token);
+      break;
+    case BlockTokenType::VERBATIMBLOCK:
+      process_verbatim_token(token);
+      break;
+    case BlockTokenType::IMAGE:
+      process_image_token(token);
+      break;
+    case BlockTokenType::NEWLINE:
+      process_newline_token(token);
+      break;
+    default:
+      handle_error("Unknown block token type", i);
+      if (!attempt_recovery(token)) {
+        throw MIGRError("Failed to recover from unkown token", i, "skip");
       }
+      break;
+    }
+  } catch (const MIGRError &e) {
+    errors_.push_back(e);
+    if (e.get_severity() == MIGRError::Severity::FATAL) {
+      throw;
     }
   }
+}
 
+void StructuralLayer::finish_build() {
   // cleaning up any remaining list context
   while (in_list_context()) {
     list_stack_.pop();
   }
+  if (inline_cache_.get_capacity() > 0) {
+    _V_ << " [StructuralLayer] Inline cache: " << inline_cache_.hits()
+        << " hits, " << inline_cache_.misses() << " misses." << std::endl;
+  }
+  _V_ << " [StructuralLayer] Interned " << strings_->size() << " strings, "
+      << strings_->bytes() << " bytes." << std::endl;
   _V_ << " [StructuralLayer] Structural Layer Built." << std::endl;
 }
 
 /*
  * Returns root node of the StructuralLayer.
  */
-std::shared_ptr<MIGRNode> StructuralLayer::get_root() const { return root_; }
+MIGRNode *StructuralLayer::get_root() const { return root_; }
+
+/*
+ * Columns of every node of the layer. Built from the node map when a node
+ * was added, removed or edited since the last call, so a burst of scans
+ * after a build pays for one pass.
+ */
+const NodeColumns &StructuralLayer::columns() const {
+  if (columns_dirty_ || columns_.edits != MIGRNode::edits()) {
+    columns_.build(nodes_);
+    columns_dirty_ = false;
+  }
+  return columns_;
+}
+
+/*
+ * Nodes of a type whose offset is in [begin, end), in id order.
+ */
+std::vector<MIGRNode *> StructuralLayer::scan(MIGRNodeType type, size_t begin,
+                                              size_t end) const {
+  const NodeColumns &cols = columns();
+  std::vector<MIGRNode *> results;
+  for (uint32_t r : cols.rows_of(type, begin, end)) {
+    results.push_back(cols.node[r]);
+  }
+  return results;
+}
+
+/*
+ * Makes a node in the layer's arena. It is not attached or added to the node
+ * map, callers do that, and it is freed with the layer (or its next
+ * deserialize).
+ */
+MIGRNode *StructuralLayer::make_node(MIGRNodeType type,
+                                     const std::string &content) {
+  return arena_.make(type, content);
+}
+
+/*
+ * Line and column of a node, worked out from its offset with the source's line
+ * table. Without a source (layer built from bare tokens or deserialized) there
+ * is nothing to look up and {0, 0} is returned.
+ */
+LinePos StructuralLayer::position(const MIGRNode &node) const {
+  if (!source_) {
+    return {0, 0};
+  }
+  return source_->lines().position(node.offset_);
+}
 
 //-----------------------//
 //      Processors       //
@@ -217,17 +318,16 @@ std::shared_ptr<MIGRNode> StructuralLayer::get_root() const { return root_; }
  * node.
  */
 void StructuralLayer::process_heading_token(const BToken &token) {
-  _V_ << " [StructuralLayer] Creating Heading Node." << std::endl;
+  TRACE(BLOCK, "StructuralLayer heading node at", token.offset);
   int level{1}; // default
 
   level = token.level.value_or(1);
 
   manage_heading_stack(level);
 
-  auto heading_node = std::make_shared<MIGRNode>(MIGRNodeType::HEADING,
-                                                 token.text.value_or(""));
-  heading_node->metadata_["level"] = std::to_string(level);
-  heading_node->loc_ = token.loc;
+  auto heading_node = make_node(MIGRNodeType::HEADING, token.text_string());
+  heading_node->attrs_.level = level;
+  heading_node->offset_ = token.offset;
 
   if (!parent_stack_.empty()) {
     parent_stack_.top()->add_child(heading_node);
@@ -236,7 +336,7 @@ void StructuralLayer::process_heading_token(const BToken &token) {
   parent_stack_.push(heading_node);
   add_node(heading_node);
 
-  process_inline_content(heading_node, token.text.value_or(""));
+  process_inline_content(heading_node, token);
 }
 
 /*
@@ -245,11 +345,10 @@ void StructuralLayer::process_heading_token(const BToken &token) {
  * And then processes inline content for the created node.
  */
 void StructuralLayer::process_paragraph_token(const BToken &token) {
-  _V_ << " [StructuralLayer] Creating Paragraph Node." << std::endl;
-  auto para_node = std::make_shared<MIGRNode>(MIGRNodeType::PARAGRAPH,
-                                              token.text.value_or(""));
+  TRACE(BLOCK, "StructuralLayer paragraph node at", token.offset);
+  auto para_node = make_node(MIGRNodeType::PARAGRAPH, token.text_string());
 
-  para_node->loc_ = token.loc;
+  para_node->offset_ = token.offset;
 
   if (!parent_stack_.empty()) {
     parent_stack_.top()->add_child(para_node);
@@ -257,7 +356,7 @@ void StructuralLayer::process_paragraph_token(const BToken &token) {
 
   add_node(para_node);
 
-  process_inline_content(para_node, token.text.value_or(""));
+  process_inline_content(para_node, token);
 }
 
 /*
@@ -267,7 +366,7 @@ void StructuralLayer::process_paragraph_token(const BToken &token) {
  * and then process inline tokens.
  */
 void StructuralLayer::process_ulist_token(const BToken &token) {
-  _V_ << " [StructuralLayer] Creating Unordered List Node." << std::endl;
+  TRACE(BLOCK, "StructuralLayer unordered list node at", token.offset);
   int level = token.level.value_or(1);
 
   while ((int)list_stack_.size() > level) {
@@ -278,9 +377,9 @@ void StructuralLayer::process_ulist_token(const BToken &token) {
     enter_list_context(MIGRNodeType::ULIST);
   }
 
-  auto list_item_node = std::make_shared<MIGRNode>(MIGRNodeType::ULIST_ITEM,
-                                                   token.text.value_or(""));
-  list_item_node->loc_ = token.loc;
+  auto list_item_node =
+      make_node(MIGRNodeType::ULIST_ITEM, token.text_string());
+  list_item_node->offset_ = token.offset;
 
   if (in_list_context()) {
     list_stack_.top()->add_child(list_item_node);
@@ -291,7 +390,7 @@ void StructuralLayer::process_ulist_token(const BToken &token) {
   }
 
   add_node(list_item_node);
-  process_inline_content(list_item_node, token.text.value_or(""));
+  process_inline_content(list_item_node, token);
 }
 
 /*
@@ -299,7 +398,7 @@ void StructuralLayer::process_ulist_token(const BToken &token) {
  * Similar handling as unordered lists but for OLIST and OLIST_ITEM types.
  */
 void StructuralLayer::process_olist_token(const BToken &token) {
-  _V_ << " [StructuralLayer] Creating Ordered List Node." << std::endl;
+  TRACE(BLOCK, "StructuralLayer ordered list node at", token.offset);
   int level = token.level.value_or(1);
 
   while ((int)list_stack_.size() > level) {
@@ -310,9 +409,9 @@ void StructuralLayer::process_olist_token(const BToken &token) {
     enter_list_context(MIGRNodeType::OLIST);
   }
 
-  auto list_item_node = std::make_shared<MIGRNode>(MIGRNodeType::OLIST_ITEM,
-                                                   token.text.value_or(""));
-  list_item_node->loc_ = token.loc;
+  auto list_item_node =
+      make_node(MIGRNodeType::OLIST_ITEM, token.text_string());
+  list_item_node->offset_ = token.offset;
 
   if (in_list_context()) {
     list_stack_.top()->add_child(list_item_node);
@@ -323,7 +422,7 @@ void StructuralLayer::process_olist_token(const BToken &token) {
   }
 
   add_node(list_item_node);
-  process_inline_content(list_item_node, token.text.value_or(""));
+  process_inline_content(list_item_node, token);
 }
 
 /*
@@ -331,9 +430,9 @@ void StructuralLayer::process_olist_token(const BToken &token) {
  * Creates a horizontal rule node and attaches it to current parent.
  */
 void StructuralLayer::process_horizontal_rule_token(const BToken &token) {
-  _V_ << " [StructuralLayer] Creating Horizontal Rule Node." << std::endl;
-  auto hr_node = std::make_shared<MIGRNode>(MIGRNodeType::HORIZONTAL_RULE);
-  hr_node->loc_ = token.loc;
+  TRACE(BLOCK, "StructuralLayer horizontal rule node at", token.offset);
+  auto hr_node = make_node(MIGRNodeType::HORIZONTAL_RULE);
+  hr_node->offset_ = token.offset;
 
   if (!parent_stack_.empty()) {
     parent_stack_.top()->add_child(hr_node);
@@ -347,10 +446,9 @@ void StructuralLayer::process_horizontal_rule_token(const BToken &token) {
  * Creates a verbatim block node, attaches to parent, and adds to map.
  */
 void StructuralLayer::process_verbatim_token(const BToken &token) {
-  _V_ << " [StructuralLayer] Creating Verbatim Node." << std::endl;
-  auto verb_node = std::make_shared<MIGRNode>(MIGRNodeType::VERBATIM_BLOCK,
-                                              token.text.value_or(""));
-  verb_node->loc_ = token.loc;
+  TRACE(BLOCK, "StructuralLayer verbatim node at", token.offset);
+  auto verb_node = make_node(MIGRNodeType::VERBATIM_BLOCK, token.text_string());
+  verb_node->offset_ = token.offset;
 
   if (!parent_stack_.empty()) {
     parent_stack_.top()->add_child(verb_node);
@@ -365,10 +463,9 @@ void StructuralLayer::process_verbatim_token(const BToken &token) {
  * adds to map
  */
 void StructuralLayer::process_image_token(const BToken &token) {
-  _V_ << " [StructuralLayer] Creating Image Node." << std::endl;
-  auto image_node =
-      std::make_shared<MIGRNode>(MIGRNodeType::IMAGE, token.text.value_or(""));
-  image_node->loc_ = token.loc;
+  TRACE(BLOCK, "StructuralLayer image node at", token.offset);
+  auto image_node = make_node(MIGRNodeType::IMAGE, token.text_string());
+  image_node->offset_ = token.offset;
 
   if (!parent_stack_.empty()) {
     parent_stack_.top()->add_child(image_node);
@@ -382,9 +479,9 @@ void StructuralLayer::process_image_token(const BToken &token) {
  * Creates a newline node, attaches, and adds to map.
  */
 void StructuralLayer::process_newline_token(const BToken &token) {
-  _V_ << " [StructuralLayer] Creating Newline Node." << std::endl;
-  auto newline_node = std::make_shared<MIGRNode>(MIGRNodeType::NEWLINE);
-  newline_node->loc_ = token.loc;
+  TRACE(BLOCK, "StructuralLayer newline node at", token.offset);
+  auto newline_node = make_node(MIGRNodeType::NEWLINE);
+  newline_node->offset_ = token.offset;
 
   if (!parent_stack_.empty()) {
     parent_stack_.top()->add_child(newline_node);
@@ -406,12 +503,8 @@ void StructuralLayer::manage_heading_stack(int heading_level) {
   while (parent_stack_.size() > 1) {
     auto curr = parent_stack_.top();
     if (curr->type_ == MIGRNodeType::HEADING) {
-      auto curr_level_it = curr->metadata_.find("level");
-      if (curr_level_it != curr->metadata_.end()) {
-        int curr_level = std::stoi(curr_level_it->second);
-        if (curr_level < heading_level) {
-          break;
-        }
+      if (curr->attrs_.level > 0 && curr->attrs_.level < heading_level) {
+        break;
       }
     } else if (curr->type_ == MIGRNodeType::DOCUMENT_ROOT) {
       break;
@@ -425,7 +518,7 @@ void StructuralLayer::manage_heading_stack(int heading_level) {
  * and pushes onto the list stack, and node map
  */
 void StructuralLayer::enter_list_context(MIGRNodeType list_type) {
-  auto list_node = std::make_shared<MIGRNode>(list_type);
+  auto list_node = make_node(list_type);
 
   if (!parent_stack_.empty()) {
     parent_stack_.top()->add_child(list_node);
@@ -456,34 +549,39 @@ bool StructuralLayer::in_list_context() const { return !list_stack_.empty(); }
 //--------------------------//
 
 /*
- * Processes inline tokens for a given blockk token MIGR node node from provided
- * text content. Uses our ILexer to generate inline tokens, converts them to
- * MIGRNodes recursively, adds inline nodes as children under the parent, and to
- * the node map.
+ * Processes inline tokens for a given blockk token MIGR node node from the
+ * token's text. Converts the inline tokens to MIGRNodes recursively, adds
+ * inline nodes as children under the parent, and to the node map.
+ * Inline tokens are made once per block: tokens already run through
+ * BLexer::process_inline_tokens are converted as they are, the others are
+ * tokenized here by the layer's own ILexer, which is reused for every block,
+ * through the inline cache so repeated block text is only tokenized once.
  */
-void StructuralLayer::process_inline_content(std::shared_ptr<MIGRNode> parent,
-                                             const std::string &content) {
-  _V_ << " [StructuralLayer] Processing Inline Tokens for parent id: "
-      << parent->id_ << "..." << std::endl;
+void StructuralLayer::process_inline_content(MIGRNode *parent,
+                                             const BToken &token) {
+  TRACE(INLINE, "StructuralLayer inline content at", token.offset);
+  std::string_view content = token.text.value_or("");
   if (content.empty()) {
     return;
   }
-  /* NOTE: we can use BLexer::process_inline_tokens but I am letting it be a
-   * isolated feature of our lexer and here we will be independently
-   * construting inline tokens */
-  ILexer i_lexer;
-  auto i_tokens = i_lexer.tokenize(content, parent->loc_);
+  const ITokenArena *i_tokens = &token.i_tokens;
+  size_t base{0}; // cached token offsets count from the start of content
+  if (i_tokens->empty()) {
+    base = source_ ? source_->offset_of(content) : std::string::npos;
+    if (base == std::string::npos) {
+      base = parent->offset_; // content is not a slice of the source
+    }
+    i_tokens = &inline_cache_.tokenize(content, i_lexer_);
+  }
 
-  for (const auto &i_token : i_tokens) {
-    auto inline_node = convert_i_tokens_to_migr_node(i_token);
+  for (const auto &i_token : i_tokens->roots()) {
+    auto inline_node =
+        convert_i_tokens_to_migr_node(*i_tokens, i_token, base);
     if (inline_node) {
       parent->add_child(inline_node);
       add_node(inline_node);
     }
   }
-
-  _V_ << " [StructuralLayer] Inline Tokens Processed for parent id: "
-      << parent->id_ << "." << std::endl;
 }
 
 /*
@@ -491,14 +589,16 @@ void StructuralLayer::process_inline_content(std::shared_ptr<MIGRNode> parent,
  * Maps inline token types to MIGRNodeTypes.
  * Also handles URLs for links and images.
  * It's a recursive function to convert and add children tokens
- * (except for links/images)
+ * (except for links/images), which are looked up in the token's arena.
+ * base is added to the token offsets, for tokens that count from their block.
  */
-std::shared_ptr<MIGRNode>
-StructuralLayer::convert_i_tokens_to_migr_node(const IToken &i_token) {
-  _V_ << "Converting InlineTokenTypes to MigrNodeTypes..." << std::endl;
+MIGRNode *
+StructuralLayer::convert_i_tokens_to_migr_node(const ITokenArena &arena,
+                                               const IToken &i_token,
+                                               size_t base) {
+  TRACE(INLINE, "StructuralLayer inline node at", i_token.offset);
   MIGRNodeType nt;
-  std::string content = i_token.content.value_or("");
-  std::string url = i_token.url.value_or("");
+  std::string content = i_token.content_string();
 
   switch (i_token.type) {
   case InlineTokenType::TEXT:
@@ -531,17 +631,19 @@ StructuralLayer::convert_i_tokens_to_migr_node(const IToken &i_token) {
     break;
   }
 
-  auto node = std::make_shared<MIGRNode>(nt, content);
+  auto node = make_node(nt, content);
+  node->offset_ = base + i_token.offset;
 
-  if (!url.empty() && (nt == MIGRNodeType::LINK || nt == MIGRNodeType::IMAGE)) {
-    node->metadata_["url"] = url;
+  if (nt == MIGRNodeType::LINK || nt == MIGRNodeType::IMAGE) {
+    node->attrs_.ref = strings_->intern(i_token.url.value_or(""));
   }
 
   /* for nested formatting we will recursively run the function */
   if (i_token.type != InlineTokenType::LINK &&
       i_token.type != InlineTokenType::IMAGE) {
-    for (const auto &child_token : i_token.children) {
-      auto child_node = convert_i_tokens_to_migr_node(child_token);
+    for (const auto &child_token : arena.children(i_token)) {
+      auto child_node =
+          convert_i_tokens_to_migr_node(arena, child_token, base);
       if (child_node) {
         node->add_child(child_node);
         add_node(child_node);
@@ -549,11 +651,35 @@ StructuralLayer::convert_i_tokens_to_migr_node(const IToken &i_token) {
     }
   }
 
-  _V_ << "Converted InlineTokenTypes to MigrNodeTypes." << std::endl;
-
   return node;
 }
 
+/*
+ * Sets how many distinct block texts keep their inline tokens, 0 turns the
+ * cache off. Hits and misses are counted in get_inline_cache().
+ */
+void StructuralLayer::set_inline_cache_size(size_t n) {
+  inline_cache_.set_capacity(n);
+}
+
+const InlineCache &StructuralLayer::get_inline_cache() const {
+  return inline_cache_;
+}
+
+/*
+ * Pool the layer interns link/image urls in. Pass one pool to several layers
+ * (set it before building) to share strings across a corpus.
+ */
+std::shared_ptr<StringPool> StructuralLayer::get_string_pool() const {
+  return strings_;
+}
+
+void StructuralLayer::set_string_pool(std::shared_ptr<StringPool> pool) {
+  if (pool) {
+    strings_ = std::move(pool);
+  }
+}
+
 //------------------------------------------//
 //      Error Handling and Recovery         //
 //------------------------------------------//
@@ -601,8 +727,8 @@ bool StructuralLayer::attempt_recovery(const BToken &token) {
   case RecoveryStrategy::ATTACH_TO_PARENT:
     // just creating generic node and attaching to parent
     if (!parent_stack_.empty()) {
-      auto recovery_node = std::make_shared<MIGRNode>(MIGRNodeType::PARAGRAPH,
-                                                      token.text.value_or(""));
+      auto recovery_node =
+          make_node(MIGRNodeType::PARAGRAPH, token.text_string());
       parent_stack_.top()->add_child(recovery_node);
       add_node(recovery_node);
       return true;
@@ -610,9 +736,8 @@ bool StructuralLayer::attempt_recovery(const BToken &token) {
     return false;
   case RecoveryStrategy::CREATE_PLACEHOLDER:
     // creating placeholder node
-    auto placeholder = std::make_shared<MIGRNode>(
-        MIGRNodeType::PARAGRAPH,
-        "[PLACEHOLDER: " + token.text.value_or("") + "]");
+    auto placeholder = make_node(MIGRNodeType::PARAGRAPH,
+                                 "[PLACEHOLDER: " + token.text_string() + "]");
     if (!parent_stack_.empty()) {
       parent_stack_.top()->add_child(placeholder);
     }
@@ -628,16 +753,10 @@ bool StructuralLayer::attempt_recovery(const BToken &token) {
 
 void StructuralLayer::print_structural_info(bool detailed) const {
   std::cout << "=== structural info ===" << std::endl;
-  std::cout << "Total Nodes: " << nodes_.size() << std::endl;
-  std::cout << "Root ID: " << (root_ ? root_->id_ : "[no root]") << std::endl;
-
-  // freq of types of nodes
-  std::unordered_map<MIGRNodeType, size_t> counts;
-  for (const auto &[_, node] : nodes_) {
-    if (node) {
-      counts[node->type_]++;
-    }
-  }
+  std::cout << "Total Nodes: " << by_type_.size() << std::endl;
+  std::cout << "Root ID: "
+            << (root_ ? MIGRNode::id_string(root_->id_) : "[no root]")
+            << std::endl;
 
   static const std::unordered_map<MIGRNodeType, std::string> type_names = {
       {MIGRNodeType::DOCUMENT_ROOT, "DOCUMENT_ROOT"},
@@ -660,8 +779,8 @@ void StructuralLayer::print_structural_info(bool detailed) const {
 
   std::cout << "\nNode Type Distribution:" << std::endl;
   for (const auto &[type, name] : type_names) {
-    if (counts[type] > 0) {
-      std::cout << "  " << name << ": " << counts[type] << std::endl;
+    if (size_t n = by_type_.count(type); n > 0) {
+      std::cout << "  " << name << ": " << n << std::endl;
     }
   }
 
@@ -671,8 +790,8 @@ void StructuralLayer::print_structural_info(bool detailed) const {
   std::cout << "\n=== more detailed ===\n--- Document Tree Structure ---"
             << std::endl;
 
-  std::function<void(const std::shared_ptr<MIGRNode> &, int)> print_tree =
-      [&](const std::shared_ptr<MIGRNode> &node, int depth) {
+  std::function<void(const MIGRNode *, int)> print_tree =
+      [&](const MIGRNode *node, int depth) {
         if (!node)
           return;
 
@@ -681,16 +800,16 @@ void StructuralLayer::print_structural_info(bool detailed) const {
             type_it != type_names.end() ? type_it->second : "UNKNOWN";
 
         std::cout << std::string(depth * 2, ' ') << "└─ " << type_name << " ["
-                  << node->id_ << "]";
+                  << MIGRNode::id_string(node->id_) << "]";
 
         // metadata
-        if (!node->metadata_.empty()) {
+        if (node->has_attrs()) {
           std::cout << " {";
           bool first = true;
-          for (const auto &[k, v] : node->metadata_) {
+          node->for_each_attr([&](std::string_view k, std::string_view v) {
             std::cout << (first ? "" : ", ") << k << ": \"" << v << "\"";
             first = false;
-          }
+          });
           std::cout << "}";
         }
 
@@ -0,0 +1,201 @@
+#include "scan.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CN_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+struct ScanBackend {
+  const char *(*find_first_of)(const char *, const char *, std::string_view);
+  size_t (*count_newlines)(const char *, const char *);
+  void (*line_starts)(const char *, const char *, size_t,
+                      std::vector<size_t> &);
+  const char *name;
+};
+
+//--------------------//
+//       Scalar       //
+//--------------------//
+
+static const char *find_first_of_scalar(const char *p, const char *end,
+                                        std::string_view set) {
+  for (; p < end; ++p) {
+    if (set.find(*p) != std::string_view::npos) {
+      return p;
+    }
+  }
+  return end;
+}
+
+static size_t count_newlines_scalar(const char *p, const char *end) {
+  size_t n{0};
+  for (; p < end; ++p) {
+    n += (*p == '\n');
+  }
+  return n;
+}
+
+static void line_starts_scalar(const char *p, const char *end, size_t base,
+                               std::vector<size_t> &out) {
+  for (const char *q = p; q < end; ++q) {
+    if (*q == '\n') {
+      out.push_back(base + (q - p) + 1);
+    }
+  }
+}
+
+#ifdef CN_SCAN_X86
+
+//------------------//
+//       SSE2       //
+//------------------//
+
+/* sse2 is part of x86-64, so this one never needs a feature check */
+static const char *find_first_of_sse2(const char *p, const char *end,
+                                      std::string_view set) {
+  if (set.size() > 8) {
+    return find_first_of_scalar(p, end, set);
+  }
+  __m128i needles[8];
+  for (size_t i{0}; i < set.size(); ++i) {
+    needles[i] = _mm_set1_epi8(set[i]);
+  }
+
+  for (; end - p >= 16; p += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i hits = _mm_setzero_si128();
+    for (size_t i{0}; i < set.size(); ++i) {
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[i]));
+    }
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return find_first_of_scalar(p, end, set);
+}
+
+static size_t count_newlines_sse2(const char *p, const char *end) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  size_t n{0};
+  for (; end - p >= 16; p += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    unsigned mask =
+        static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, nl)));
+    n += __builtin_popcount(mask);
+  }
+  return n + count_newlines_scalar(p, end);
+}
+
+static void line_starts_sse2(const char *p, const char *end, size_t base,
+                             std::vector<size_t> &out) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  const char *q = p;
+  for (; end - q >= 16; q += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(q));
+    unsigned mask =
+        static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, nl)));
+    for (; mask; mask &= mask - 1) {
+      out.push_back(base + (q - p) + __builtin_ctz(mask) + 1);
+    }
+  }
+  line_starts_scalar(q, end, base + (q - p), out);
+}
+
+//------------------//
+//       AVX2       //
+//------------------//
+
+static __attribute__((target("avx2"))) const char *
+find_first_of_avx2(const char *p, const char *end, std::string_view set) {
+  if (set.size() > 8) {
+    return find_first_of_scalar(p, end, set);
+  }
+  __m256i needles[8];
+  for (size_t i{0}; i < set.size(); ++i) {
+    needles[i] = _mm256_set1_epi8(set[i]);
+  }
+
+  for (; end - p >= 32; p += 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i hits = _mm256_setzero_si256();
+    for (size_t i{0}; i < set.size(); ++i) {
+      hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, needles[i]));
+    }
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return find_first_of_sse2(p, end, set);
+}
+
+static __attribute__((target("avx2"))) size_t
+count_newlines_avx2(const char *p, const char *end) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  size_t n{0};
+  for (; end - p >= 32; p += 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    unsigned mask = static_cast<unsigned>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, nl)));
+    n += __builtin_popcount(mask);
+  }
+  return n + count_newlines_sse2(p, end);
+}
+
+static __attribute__((target("avx2"))) void
+line_starts_avx2(const char *p, const char *end, size_t base,
+                 std::vector<size_t> &out) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  const char *q = p;
+  for (; end - q >= 32; q += 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(q));
+    unsigned mask = static_cast<unsigned>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, nl)));
+    for (; mask; mask &= mask - 1) {
+      out.push_back(base + (q - p) + __builtin_ctz(mask) + 1);
+    }
+  }
+  line_starts_sse2(q, end, base + (q - p), out);
+}
+
+#endif // CN_SCAN_X86
+
+static ScanBackend pick_backend() {
+#ifdef CN_SCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return {find_first_of_avx2, count_newlines_avx2, line_starts_avx2, "avx2"};
+  }
+  return {find_first_of_sse2, count_newlines_sse2, line_starts_sse2, "sse2"};
+#else
+  return {find_first_of_scalar, count_newlines_scalar, line_starts_scalar,
+          "scalar"};
+#endif
+}
+
+/* picked on first use, so scanning is safe from static initializers too */
+static const ScanBackend &backend() {
+  static const ScanBackend picked = pick_backend();
+  return picked;
+}
+
+const char *find_first_of(const char *p, const char *end,
+                          std::string_view set) {
+  return backend().find_first_of(p, end, set);
+}
+
+const char *find_newline(const char *p, const char *end) {
+  return backend().find_first_of(p, end, "\n");
+}
+
+size_t count_newlines(const char *p, const char *end) {
+  return backend().count_newlines(p, end);
+}
+
+void line_starts(const char *p, const char *end, size_t base,
+                 std::vector<size_t> &out) {
+  backend().line_starts(p, end, base, out);
+}
+
+const char *scan_backend() { return backend().name; }
@@ -0,0 +1,48 @@
+#include "string_pool.h"
+#include "hash.h"
+#include <algorithm>
+#include <cstring>
+
+size_t StringPool::Hash::operator()(std::string_view s) const {
+  return static_cast<size_t>(hash64(s));
+}
+
+/*
+ * Handle of s, adding it to the pool if it is not there yet.
+ */
+InternedStr StringPool::intern(std::string_view s) {
+  if (s.empty()) {
+    return {};
+  }
+  auto it = index.find(s);
+  if (it != index.end()) {
+    return InternedStr(it->second);
+  }
+  const std::string_view *entry = &entries.emplace_back(store(s));
+  index.emplace(*entry, entry);
+  return InternedStr(entry);
+}
+
+InternedStr StringPool::find(std::string_view s) const {
+  auto it = index.find(s);
+  return it != index.end() ? InternedStr(it->second) : InternedStr();
+}
+
+/*
+ * Copies s into the current chunk, strings longer than a chunk get one of
+ * their own.
+ */
+std::string_view StringPool::store(std::string_view s) {
+  if (s.size() > chunk_left) {
+    size_t n = std::max(chunk_size, s.size());
+    chunks.emplace_back(new char[n]); // not zeroed, unlike make_unique
+    chunk_pos = chunks.back().get();
+    chunk_left = n;
+  }
+  std::memcpy(chunk_pos, s.data(), s.size());
+  std::string_view stored(chunk_pos, s.size());
+  chunk_pos += s.size();
+  chunk_left -= s.size();
+  used += s.size();
+  return stored;
+}
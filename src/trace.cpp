@@ -0,0 +1,53 @@
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+
+/*
+ * One slot of the ring. seq is the event number plus one once the slot is
+ * written, 0 while a writer is in it; every field is atomic so a dump running
+ * next to the writers reads torn slots as skipped instead of racing.
+ * Events carry no timestamp, reading a clock would cost more than the rest of
+ * the event; the event number orders them.
+ */
+struct TraceSlot {
+  std::atomic<uint64_t> seq{0};
+  std::atomic<const char *> msg{nullptr};
+  std::atomic<uint64_t> arg{0};
+};
+
+static TraceSlot ring[trace_capacity];
+static std::atomic<uint64_t> head{0};
+
+void trace_event(const char *msg, uint64_t arg) {
+  uint64_t n = head.fetch_add(1, std::memory_order_relaxed);
+  TraceSlot &s = ring[n & (trace_capacity - 1)];
+  s.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  s.msg.store(msg, std::memory_order_relaxed);
+  s.arg.store(arg, std::memory_order_relaxed);
+  s.seq.store(n + 1, std::memory_order_release);
+}
+
+/*
+ * Prints the last events still in the ring as "[TRACE] #<event> <msg> <arg>".
+ * Slots overwritten or still being written while we read are left out.
+ */
+void trace_dump(std::ostream &out, size_t last) {
+  uint64_t end = head.load(std::memory_order_acquire);
+  uint64_t n = std::min<uint64_t>({end, last, trace_capacity});
+
+  for (uint64_t i = end - n; i < end; ++i) {
+    TraceSlot &s = ring[i & (trace_capacity - 1)];
+    if (s.seq.load(std::memory_order_acquire) != i + 1) {
+      continue;
+    }
+    const char *msg = s.msg.load(std::memory_order_relaxed);
+    uint64_t arg = s.arg.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (s.seq.load(std::memory_order_relaxed) != i + 1) {
+      continue;
+    }
+    out << "[TRACE] #" << i << " " << msg << " " << arg << "\n";
+  }
+  out.flush();
+}
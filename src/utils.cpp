@@ -1,11 +1,15 @@
 #include "utils.h"
 #include "globals.h"
+#include <charconv>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
 /* prints usage info on console */
 void usage(const std::string &program) {
-  std::cout << "Usage: " << program << " <input filepath>" << std::endl;
+  std::cout << "Usage: " << program
+            << " [-v] [-j <threads>] [-c <blocks>] <input filepath | ->"
+            << std::endl;
 }
 
 /* opens file and reads it's content into a string and returns it */
@@ -20,6 +24,24 @@ std::string read_creole_file(const std::string &filepath) {
   return content;
 }
 
+/*
+ * Reads a whole decimal number in [min, max] from an option's value, anything
+ * else (empty, a sign, trailing chars, out of range) prints usage and exits.
+ */
+static size_t parse_count(const char *program, const std::string &option,
+                          const char *value, size_t min, size_t max) {
+  size_t n{0};
+  const char *end = value + std::strlen(value);
+  auto [ptr, ec] = std::from_chars(value, end, n);
+  if (ec != std::errc() || ptr != end || n < min || n > max) {
+    std::cerr << "Invalid value for " << option << ": " << value << " ("
+              << min << " to " << max << ")" << std::endl;
+    usage(program);
+    exit(1);
+  }
+  return n;
+}
+
 /* parses the cli arguments, stores them in Args struct and returns it */
 Args parse_args(int argc, char *argv[]) {
   if (argc < 2) {
@@ -33,6 +55,11 @@ Args parse_args(int argc, char *argv[]) {
     std::string arg = argv[i];
     if ((arg == "--verbose" || arg == "-v") && i < argc) {
       verbose = true;
+    } else if ((arg == "--jobs" || arg == "-j") && i + 1 < argc) {
+      args.jobs = parse_count(argv[0], arg, argv[++i], 1, max_jobs);
+    } else if ((arg == "--inline-cache" || arg == "-c") && i + 1 < argc) {
+      args.inline_cache =
+          parse_count(argv[0], arg, argv[++i], 0, max_inline_cache);
     } else if (arg.rfind("--", 0) == 0) {
       std::cerr << "Unknown option: " << arg << "\n";
       usage(argv[0]);
@@ -73,3 +100,17 @@ std::string rtrim(const std::string &str) {
 /* trims whitespace from left and right
 both direction of string and returns it */
 std::string trim(const std::string &str) { return ltrim(rtrim(str)); }
+
+/* trims whitespace from both directions without copying, the returned view
+points into the same buffer as str */
+std::string_view trim_view(std::string_view str) {
+  size_t i = 0;
+  while (i < str.size() && std::isspace(static_cast<unsigned char>(str[i]))) {
+    i++;
+  }
+  size_t j = str.size();
+  while (j > i && std::isspace(static_cast<unsigned char>(str[j - 1]))) {
+    j--;
+  }
+  return str.substr(i, j - i);
+}
@@ -0,0 +1,29 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/* stops the test at the first failed condition */
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed"  \
+                << std::endl;                                                  \
+      std::exit(1);                                                            \
+    }                                                                          \
+  } while (0)
+
+/* contents of a file under tests/ */
+inline std::string read_test_file(const std::string &name) {
+  std::ifstream in(std::string(CN_TESTS_DIR) + "/" + name);
+  CHECK(in);
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+#endif //! CHECK_H
@@ -0,0 +1,85 @@
+#include "check.h"
+#include "i_lexer.h"
+#include <string>
+#include <vector>
+
+/*
+ * Nested bold/italic spans are lexed in the same pass as their parent. The
+ * trees must be the ones a second ILexer run over each span's text gives;
+ * the expected dumps below were taken from that recursive implementation.
+ */
+static void dump(const ITokenArena &arena, std::span<const IToken> tokens,
+                 int depth, std::string &out) {
+  for (const IToken &t : tokens) {
+    out += std::string(depth, ' ') + ILexer::token_type_to_string(t.type) +
+           " " + std::to_string(t.offset);
+    if (t.content.has_value()) {
+      out += " " + t.content_string();
+    }
+    out += "\n";
+    dump(arena, arena.children(t), depth + 1, out);
+  }
+}
+
+static void check_tree(ILexer &lexer, std::string_view input,
+                       const std::string &want) {
+  const ITokenArena &arena = lexer.tokenize_in_place(input);
+  std::string got;
+  dump(arena, arena.roots(), 0, got);
+  if (got != want) {
+    std::cerr << "input: " << input << "\ngot:\n" << got << std::endl;
+  }
+  CHECK(got == want);
+}
+
+/* bare urls are linked without their trailing punctuation, others are text */
+static void check_bare_urls(ILexer &lexer) {
+  std::string text = read_test_file("unit_tests/bare_urls.creole");
+  std::vector<std::string> urls;
+  for (const IToken &t : lexer.tokenize_in_place(text).roots()) {
+    if (t.type == InlineTokenType::LINK) {
+      CHECK(t.content == t.url);
+      urls.push_back(t.url_string());
+    }
+  }
+  std::vector<std::string> want{"http://example.com",
+                                "https://example.com/docs/index.html",
+                                "https://example.com/help?q=a,b"};
+  CHECK(urls == want);
+}
+
+int main() {
+  // one lexer for every case, the nested lexers are reused across blocks
+  ILexer lexer;
+  check_tree(lexer, "**bold //italic// more**",
+             "BOLD 0\n"
+             " TEXT 2 bold \n"
+             " ITALIC 7\n"
+             "  TEXT 9 italic\n"
+             " TEXT 17  more\n");
+  // the url stops where the outer span closes
+  check_tree(lexer, "**a http://x.y/z** b",
+             "BOLD 0\n"
+             " TEXT 2 a \n"
+             " LINK 4 http://x.y/z\n"
+             "TEXT 18  b\n");
+  check_tree(lexer, "**//x//**//**y**//",
+             "BOLD 0\n"
+             " ITALIC 2\n"
+             "  TEXT 4 x\n"
+             "ITALIC 9\n"
+             " BOLD 11\n"
+             "  TEXT 13 y\n");
+  check_tree(lexer, "**a {{{v}}} b**",
+             "BOLD 0\n"
+             " TEXT 2 a \n"
+             " VERBATIM 4 v\n"
+             " TEXT 11  b\n");
+  check_tree(lexer, "**a [[P|t]] b**",
+             "BOLD 0\n"
+             " TEXT 2 a \n"
+             " LINK 4 t\n"
+             " TEXT 11  b\n");
+  check_bare_urls(lexer);
+  return 0;
+}
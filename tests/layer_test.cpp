@@ -0,0 +1,176 @@
+#include "b_lexer.h"
+#include "check.h"
+#include "error.h"
+#include "migr_semantic.h"
+#include "migr_structural.h"
+#include <sstream>
+#include <string>
+
+/* a structural layer file with the given ids for a root and its paragraph */
+static std::string layer_json(const std::string &root_id,
+                              const std::string &child_id) {
+  std::string root = std::to_string(int(MIGRNodeType::DOCUMENT_ROOT));
+  std::string para = std::to_string(int(MIGRNodeType::PARAGRAPH));
+  return R"({"structural_layer":{"root":")" + root_id + R"(","nodes":{")" +
+         root_id + R"(":{"type":)" + root + R"(,"content":"","children":[")" +
+         child_id + R"("]},")" + child_id + R"(":{"type":)" + para +
+         R"(,"content":"hi","children":[],"parent":")" + root_id +
+         R"("}}}})";
+}
+
+/*
+ * Loaded nodes keep the ids of the file, however far apart, and nodes made
+ * afterwards get ids above them.
+ */
+static void check_sparse_ids() {
+  std::istringstream in(layer_json("node_4000000000", "node_7"));
+  StructuralLayer layer;
+  layer.deserialize(in);
+
+  MIGRNode *root = layer.get_root();
+  CHECK(root);
+  CHECK(root->children_.size() == 1);
+  MIGRNode *para = root->children_[0];
+  CHECK(para->parent_ == root);
+  CHECK(para->content_ == "hi");
+  CHECK(layer.nodes_of_type(MIGRNodeType::PARAGRAPH).size() == 1);
+  CHECK(root->id_ == 4000000000u && para->id_ == 7);
+  CHECK(layer.get_neighbours(root->id_).size() == 1);
+  CHECK(layer.get_neighbours(4000000000u)[0] == para);
+
+  MIGRNode *added = layer.make_node(MIGRNodeType::PARAGRAPH, "new");
+  CHECK(added->id_ > 4000000000u);
+  layer.add_node(added);
+  CHECK(layer.nodes_of_type(MIGRNodeType::PARAGRAPH).size() == 2);
+}
+
+/*
+ * The counter stops one short of the last NodeId instead of wrapping to
+ * no_node. It is global, so this runs after every other check.
+ */
+static void check_counter_exhausted() {
+  std::istringstream in(layer_json("node_1", "node_4294967294"));
+  StructuralLayer layer;
+  layer.deserialize(in);
+  CHECK(layer.get_root()->children_[0]->id_ == 4294967294u);
+  bool thrown{false};
+  try {
+    MIGRNode node(MIGRNodeType::PARAGRAPH, "x");
+  } catch (const CNError &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+/* an id that does not fit a NodeId is an error, the layer is left empty */
+static void check_id_overflow() {
+  std::istringstream in(layer_json("node_1", "node_99999999999"));
+  StructuralLayer layer;
+  bool thrown{false};
+  try {
+    layer.deserialize(in);
+  } catch (const CNError &) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  CHECK(!layer.get_root());
+  CHECK(layer.nodes_of_type(MIGRNodeType::DOCUMENT_ROOT).empty());
+  CHECK(layer.columns().size() == 0);
+}
+
+static void build(StructuralLayer &layer, const std::string &text) {
+  BLexer lexer(CreoleSource::from_string(text));
+  layer.build_from_stream(lexer, lexer.get_source());
+}
+
+/*
+ * The SemanticLayer owns copies of the LINK nodes, it stays usable after the
+ * StructuralLayer it was extracted from is reloaded and destroyed.
+ */
+static void check_semantic_outlives_structural() {
+  SemanticLayer semantic;
+  {
+    StructuralLayer structural;
+    build(structural, "See [[Page]] and [[Page|again]].\n"
+                      "\n"
+                      "Tagged [[#todo]].\n");
+    semantic.extract_semantics(structural);
+    // reloading frees every node the layer had
+    std::stringstream json;
+    structural.serialize(json);
+    structural.deserialize(json);
+    CHECK(structural.nodes_of_type(MIGRNodeType::LINK).size() == 3);
+  }
+
+  CHECK(semantic.nodes_of_type(MIGRNodeType::LINK).size() == 3);
+  std::vector<MIGRNode *> links = semantic.find_all_links_to_target("Page");
+  CHECK(links.size() == 2);
+  CHECK(links[0]->content_ == "Page");
+  CHECK(links[1]->content_ == "again");
+  for (MIGRNode *link : links) {
+    CHECK(link->attrs_.ref.view() == "Page");
+    CHECK(semantic.get_semantic_targets(link->id_).size() == 1);
+  }
+
+  std::vector<MIGRNode *> tagged = semantic.search_tag("todo");
+  CHECK(tagged.size() == 2); // the tag and the link to it
+  CHECK(tagged[0]->type_ == MIGRNodeType::TAG);
+  CHECK(tagged[1]->content_ == "#todo");
+  CHECK(semantic.find_backlinks(tagged[0]->id_).size() == 1);
+}
+
+/* a scan after update_content sees the new content, not the freed one */
+static void check_edit_rebuilds_columns() {
+  StructuralLayer structural;
+  build(structural, "Tagged [[#todo]].\n");
+  SemanticLayer semantic;
+  semantic.extract_semantics(structural);
+  std::vector<MIGRNode *> tagged = semantic.search_tag("todo");
+  CHECK(!tagged.empty() && tagged[0]->type_ == MIGRNodeType::TAG);
+
+  MIGRNode *tag = tagged[0];
+  tag->update_content(std::string(64, 'x')); // too long to stay in place
+  CHECK(semantic.search_tag("todo").empty());
+  std::vector<MIGRNode *> renamed = semantic.search_tag(std::string(64, 'x'));
+  CHECK(!renamed.empty() && renamed[0] == tag);
+}
+
+/* a level that is not a positive int is kept as text in extra */
+static void check_level_attr() {
+  StringPool pool;
+  for (const char *bad : {"0", "-2", "x", "3a", "", "99999999999"}) {
+    MIGRNode node(MIGRNodeType::HEADING, "h");
+    node.set_attr("level", bad, pool);
+    CHECK(node.attrs_.level == 0);
+    CHECK(node.attrs_.extra.size() == 1);
+    CHECK(node.attrs_.extra[0].second == bad);
+  }
+  MIGRNode node(MIGRNodeType::HEADING, "h");
+  node.set_attr("level", "2147483647", pool);
+  CHECK(node.attrs_.level == 2147483647 && node.attrs_.extra.empty());
+}
+
+/* setting an attribute changes the subtree hash of the node and its parents */
+static void check_attr_rehash() {
+  StringPool pool;
+  MIGRNode parent(MIGRNodeType::PARAGRAPH, "p");
+  MIGRNode link(MIGRNodeType::LINK, "l");
+  parent.add_child(&link);
+  for (const char *key : {"url", "link_type", "level", "other"}) {
+    uint64_t before = parent.subtree_hash();
+    link.set_attr(key, key == std::string("link_type") ? "external" : "2",
+                  pool);
+    CHECK(parent.subtree_hash() != before);
+  }
+}
+
+int main() {
+  check_sparse_ids();
+  check_id_overflow();
+  check_semantic_outlives_structural();
+  check_edit_rebuilds_columns();
+  check_attr_rehash();
+  check_level_attr();
+  check_counter_exhausted();
+  return 0;
+}
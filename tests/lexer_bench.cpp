@@ -0,0 +1,114 @@
+#include "b_lexer.h"
+#include "i_lexer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+/*
+ * Lexer throughput on generated inputs, best of 5 runs.
+ *   lexer_bench [scale]   scale 1 (default) is ~30MB of block input
+ *   lexer_bench 0         tiny sizes, only checks that everything runs
+ * Only the public lexer API is used, so the file also builds against older
+ * revisions of the tree to compare before/after numbers.
+ */
+
+static double best_of(int runs, const std::function<void()> &f) {
+  double best = 1e30;
+  for (int i{0}; i < runs; ++i) {
+    auto t0 = std::chrono::steady_clock::now();
+    f();
+    auto t1 = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+  }
+  return best;
+}
+
+/* paragraphs of plain text, the common case */
+static std::string paragraph_doc(size_t bytes) {
+  std::string doc;
+  while (doc.size() < bytes) {
+    for (int line{0}; line < 4; ++line) {
+      doc += "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+             "eiusmod tempor incididunt ut labore.\n";
+    }
+    doc += "\n";
+  }
+  return doc;
+}
+
+/* every block type, with markup in the inline content */
+static std::string mixed_doc(size_t bytes) {
+  std::string doc;
+  while (doc.size() < bytes) {
+    doc += "== Section heading\n"
+           "Some **bold** and //italic// text with a [[Page|link]].\n"
+           "\n"
+           "* item one\n"
+           "** item two with http://example.com/path\n"
+           "# ordered\n"
+           "\n"
+           "{{{\n"
+           "verbatim line\n"
+           "}}}\n"
+           "----\n"
+           "{{image.png|alt}}\n"
+           "\n";
+  }
+  return doc;
+}
+
+static std::string repeat(const std::string &s, size_t n) {
+  std::string out;
+  out.reserve(s.size() * n);
+  for (size_t i{0}; i < n; ++i) {
+    out += s;
+  }
+  return out;
+}
+
+static void report(const char *name, size_t bytes, double secs) {
+  std::printf("%-24s %10zu bytes %9.4f s %8.1f MB/s %7.2f ns/byte\n", name,
+              bytes, secs, bytes / secs / 1e6, secs * 1e9 / bytes);
+}
+
+static void bench_block(const char *name, const std::string &doc) {
+  size_t n_tokens{0};
+  double secs = best_of(5, [&] {
+    BLexer lexer(CreoleSource::from_string(doc));
+    lexer.b_tokenize();
+    n_tokens = lexer.get_tokens().size();
+  });
+  report(name, doc.size(), secs);
+  if (n_tokens == 0) {
+    std::exit(1);
+  }
+}
+
+static void bench_inline(const char *name, const std::string &text) {
+  ILexer lexer;
+  double secs = best_of(5, [&] {
+    auto tokens = lexer.tokenize(text);
+    (void)tokens;
+  });
+  report(name, text.size(), secs);
+}
+
+int main(int argc, char *argv[]) {
+  double scale = argc > 1 ? std::atof(argv[1]) : 1.0;
+  size_t block_bytes = std::max<size_t>(scale * 30e6, 4096);
+  size_t reps = std::max<size_t>(scale * 1e5, 10);
+
+  bench_block("block/paragraphs", paragraph_doc(block_bytes));
+  bench_block("block/mixed", mixed_doc(block_bytes));
+
+  bench_inline("inline/flat", repeat("plain words and a few more ", reps));
+  // one span holding many nested ones, the case nesting costs most
+  bench_inline("inline/nested",
+               "**" + repeat(" (a//b//) ", reps) + "**");
+  // spans three lexers deep, over and over
+  bench_inline("inline/deep", repeat("**//x//**//**y**//", reps));
+  return 0;
+}
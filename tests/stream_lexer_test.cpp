@@ -0,0 +1,65 @@
+#include "b_lexer.h"
+#include "b_stream_lexer.h"
+#include "check.h"
+#include "migr_structural.h"
+#include <sstream>
+#include <vector>
+
+/*
+ * BStreamLexer has to hand out exactly the tokens BLexer makes from the whole
+ * input, whatever the chunk size: batches end at block boundaries and the
+ * rest of a block cut by a read stays buffered for the next batch.
+ */
+static void check_same_tokens(const std::string &text, size_t chunk) {
+  BLexer whole(CreoleSource::from_string(text));
+  whole.b_tokenize();
+  const std::vector<BToken> &want = whole.get_tokens();
+
+  std::istringstream in(text);
+  BStreamLexer stream(in, chunk);
+  BToken t;
+  size_t i{0};
+  bool carried{false}; // a block was cut by a read and held over
+  while (stream.next_token(t)) {
+    CHECK(i < want.size());
+    CHECK(t.type == want[i].type);
+    CHECK(t.offset == want[i].offset);
+    CHECK(t.text == want[i].text);
+    CHECK(t.level == want[i].level);
+    carried = carried || stream.buffered_bytes() > 0;
+    ++i;
+  }
+  CHECK(i == want.size());
+  if (chunk < text.size() / 4) {
+    CHECK(carried);
+  }
+}
+
+/* the tree built from the stream has the same shape as from the file */
+static void check_same_tree(const std::string &text) {
+  BLexer whole(CreoleSource::from_string(text));
+  StructuralLayer from_whole;
+  from_whole.build_from_stream(whole, whole.get_source());
+
+  std::istringstream in(text);
+  BStreamLexer stream(in, 16);
+  StructuralLayer from_stream;
+  from_stream.build_from_stream(stream);
+
+  for (size_t k{0}; k < node_type_count; ++k) {
+    auto type = static_cast<MIGRNodeType>(k);
+    CHECK(from_stream.nodes_of_type(type).size() ==
+          from_whole.nodes_of_type(type).size());
+  }
+  CHECK(from_stream.get_root()->subtree_hash() ==
+        from_whole.get_root()->subtree_hash());
+}
+
+int main() {
+  std::string text = read_test_file("unit_tests/stream_batches.creole");
+  for (size_t chunk : {1, 2, 3, 7, 16, 31, 64, 100, 4096}) {
+    check_same_tokens(text, chunk);
+  }
+  check_same_tree(text);
+  return 0;
+}